@@ -0,0 +1,224 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks of the components of LcskppSparseFast. Inputs sweep k, the
+// alphabet size and the similarity of the strings, results are written as
+// JSON (see util/benchmark.h).
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "fast_simple_lcsk/kmer_index.h"
+#include "fast_simple_lcsk/match_events_queue.h"
+#include "fast_simple_lcsk/match_maker.h"
+#include "fast_simple_lcsk/rolling_hasher.h"
+#include "fast_simple_lcsk/sparse_dp.h"
+#include "util/benchmark.h"
+#include "util/object_counter.h"
+#include "util/sequence_generator.h"
+#include "util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+const string kNuc = "ACTG";
+const string kProtein = "ACDEFGHIKLMNPQRSTVWY";
+
+// Substitution rates, 1 stands for unrelated strings.
+const double kPerrs[] = {0.01, 0.1, 0.3, 1.0};
+const int kKs[] = {4, 8, 12, 16};
+// The row queries are compared on the first this many rows. Forcing the
+// amortized query on every row is quadratic for similar strings.
+const int kMaxDpRows = 20000;
+
+// The hashing benchmark writes its sum here, so that its loop is not
+// optimized out.
+volatile unsigned long long hash_sink;
+
+typedef void (*RowQuery)(int k, int row, MatchEventsQueue<int>* events,
+                         vector<TableEntry<int>>* compressed_table,
+                         ObjectCounter* match_pairs);
+
+// The dp of SparseDp with a fixed row query, timing the queries and the
+// updates separately. Positions are 32-bit, as for all but huge strings.
+struct DpRun {
+  double query_seconds = 0;
+  double update_seconds = 0;
+  ObjectCounter match_pairs;
+  vector<TableEntry<int>> compressed_table;
+
+  DpRun(int k, const vector<vector<int>>& matches, RowQuery row_query) {
+    MatchEventsQueue<int> events;
+    vector<MatchPairRef<int>> prev_row;
+    compressed_table.push_back(TableEntry<int>{nullptr, 0, -1});
+    const int num_rows = matches.size();
+    for (int row = 0; row < num_rows; ++row) {
+      for (int col : matches[row]) {
+        events.AddBegin(make_tuple(row, col, nullptr));
+      }
+      Stopwatch stopwatch;
+      row_query(k, row, &events, &compressed_table, &match_pairs);
+      query_seconds += stopwatch.Seconds();
+      stopwatch.Restart();
+      RowUpdate(k, row, &events, &compressed_table, &prev_row, true);
+      update_seconds += stopwatch.Seconds();
+    }
+  }
+
+  // The pairs have to be freed before the counter.
+  ~DpRun() { compressed_table.clear(); }
+};
+
+void BenchmarkConfig(BenchmarkRunner* runner, uint64_t seed, int n, int k,
+                     const string& alphabet, double p_err) {
+  SequenceGenerator generator(seed, alphabet);
+  const string a = generator.Random(n);
+  MutationRates rates;
+  rates.substitution = p_err;
+  const string b = p_err < 1 ? generator.Mutate(a, rates) : generator.Random(n);
+  const BenchmarkParams params = {{"n", (double)n},
+                                  {"k", (double)k},
+                                  {"alphabet_size", (double)alphabet.size()},
+                                  {"p_err", p_err}};
+  vector<char> char_to_id(256, 0);
+  for (size_t i = 0; i < alphabet.size(); ++i) {
+    char_to_id[(unsigned char)alphabet[i]] = i;
+  }
+
+  runner->Run("RollingHasher::Next", params, n, [&]() {
+    Stopwatch stopwatch;
+    RollingHasher hasher(a, k, char_to_id, alphabet.size());
+    unsigned long long hash, sum = 0;
+    while (hasher.Next(&hash)) {
+      sum += hash;
+    }
+    const double seconds = stopwatch.Seconds();
+    hash_sink = sum;
+    return seconds;
+  });
+
+  runner->Run("KmerIndex::Build", params, n, [&]() {
+    Stopwatch stopwatch;
+    KmerIndex index;
+    index.Build(b, k, char_to_id, alphabet.size(), 1);
+    return stopwatch.Seconds();
+  });
+
+  vector<vector<int>> matches;
+  runner->Run("GetNextMatches", params, n, [&]() {
+    PerfectHashMatchMaker match_maker(a, b, k);
+    matches.clear();
+    vector<int> row_matches;
+    Stopwatch stopwatch;
+    while (match_maker.GetNextMatches(&row_matches)) {
+      matches.push_back(row_matches);
+    }
+    return stopwatch.Seconds();
+  });
+  matches.resize(min(a.size() + 1, (size_t)kMaxDpRows));
+  long long num_matches = 0;
+  for (const auto& row_matches : matches) {
+    num_matches += row_matches.size();
+  }
+
+  runner->Run("AmortizedRowQuery", params, num_matches, [&]() {
+    DpRun run(k, matches, AmortizedRowQuery<int>);
+    return run.query_seconds;
+  });
+  runner->Run("ElementwiseRowQuery", params, num_matches, [&]() {
+    DpRun run(k, matches, ElementwiseRowQuery<int>);
+    return run.query_seconds;
+  });
+  runner->Run("RowUpdate", params, num_matches, [&]() {
+    DpRun run(k, matches, ElementwiseRowQuery<int>);
+    return run.update_seconds;
+  });
+
+  DpRun run(k, matches, AmortizedRowQuery<int>);
+  const MatchPairRef<int> best = run.compressed_table.back().ref();
+  runner->Run("FillLcskReconstruction", params, run.compressed_table.size() - 1,
+              [&]() {
+                Stopwatch stopwatch;
+                auto runs = FillLcskReconstruction(k, best);
+                return stopwatch.Seconds();
+              });
+}
+
+void PrintUsageAndExit() {
+  printf(
+    "Microbenchmarks of the LCSk++ components.\n\n"
+    "Usage: ./bench_lcsk [--n N] [--min-time SECONDS] [--seed SEED]\n"
+    "                    [--out FILE]\n"
+    "Strings of length N (default 100000) are compared, the dp benchmarks\n"
+    "go over their first 20000 rows. Every benchmark runs for at least\n"
+    "SECONDS (default 0.2). Results are written to FILE as JSON, to the\n"
+    "standard output by default.\n");
+  exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int n = 100000;
+  double min_seconds = 0.2;
+  uint64_t seed = 1603;
+  const char* out_path = nullptr;
+  for (int i = 1; i < argc; ++i) {
+    const string flag = argv[i];
+    if (i + 1 == argc) {
+      PrintUsageAndExit();
+    }
+    if (flag == "--n") {
+      n = atoi(argv[++i]);
+    } else if (flag == "--min-time") {
+      min_seconds = atof(argv[++i]);
+    } else if (flag == "--seed") {
+      seed = strtoull(argv[++i], nullptr, 10);
+    } else if (flag == "--out") {
+      out_path = argv[++i];
+    } else {
+      PrintUsageAndExit();
+    }
+  }
+
+  BenchmarkRunner runner(min_seconds);
+  const string alphabets[] = {kNuc, kProtein};
+  for (const string& alphabet : alphabets) {
+    for (int k : kKs) {
+      // Perfect hashes have to fit into 64 bits and the number of matches
+      // of unrelated strings should stay within a small multiple of n.
+      double kmers = 1;
+      for (int i = 0; i < k; ++i) {
+        kmers *= alphabet.size();
+      }
+      if (kmers >= 18446744073709551616.0 || 16 * kmers < n) continue;
+      for (double p_err : kPerrs) {
+        BenchmarkConfig(&runner, seed++, n, k, alphabet, p_err);
+      }
+    }
+  }
+
+  FILE* out = out_path != nullptr ? fopen(out_path, "w") : stdout;
+  if (out == nullptr) {
+    fprintf(stderr, "Can not open %s\n", out_path);
+    return 1;
+  }
+  runner.WriteJson(out);
+  if (out != stdout) fclose(out);
+  return 0;
+}
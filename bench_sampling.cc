@@ -0,0 +1,193 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Accuracy and speed of the row sampling approximation of LcskppSparseFast
+// (see LcskppParams::row_sampling) against the exact results. For every
+// mutation rate several pairs of mutated sequences are compared exactly and
+// with every sampling rate, strided and hashed. The errors of the lower
+// bound and of the estimate, relative to the exact length, are summarized
+// over the pairs, together with the speedup and how often the exact length
+// was within the bounds.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "fast_simple_lcsk/lcsk.h"
+#include "util/sequence_generator.h"
+#include "util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+const double kPerrs[] = {0.01, 0.05, 0.1, 0.2};
+const int kSamplings[] = {2, 3, 4, 6, 8, 12, 16};
+
+struct Options {
+  int k = 12;
+  long long n = 1000000;
+  int pairs = 5;
+  uint64_t seed = 1603;
+  const char* out_path = nullptr;
+};
+
+// Errors relative to the exact length over the pairs of a configuration.
+struct ErrorSummary {
+  double sum = 0;
+  double sum_squares = 0;
+  double max_abs = 0;
+  int count = 0;
+
+  void Add(double error) {
+    sum += error;
+    sum_squares += error * error;
+    max_abs = max(max_abs, fabs(error));
+    ++count;
+  }
+  double mean() const { return sum / count; }
+  double stddev() const {
+    return sqrt(max(0.0, sum_squares / count - mean() * mean()));
+  }
+};
+
+struct Measurement {
+  double seconds;
+  LcskppResult result;
+};
+
+Measurement Measure(const string& a, const string& b,
+                    const LcskppParams& params) {
+  Stopwatch stopwatch;
+  LcskppResult result = LcskppSparseFastRuns(a, b, params);
+  return Measurement{stopwatch.Seconds(), result};
+}
+
+void PrintUsageAndExit() {
+  printf(
+    "Accuracy of the row sampling approximation of LcskppSparseFast.\n\n"
+    "Usage: ./bench_sampling [--k K] [--n N] [--pairs PAIRS] [--seed SEED]\n"
+    "                        [--out FILE]\n"
+    "For mutation rates 0.01 to 0.2, PAIRS (default 5) pairs of sequences\n"
+    "of length N (default 1000000) are compared with k K (default 12),\n"
+    "exactly and sampling every 2nd to 16th row, strided and hashed. The\n"
+    "mean, standard deviation and largest absolute value of the relative\n"
+    "errors of the lower bound and the estimate are reported, with the\n"
+    "speedup and the fraction of the pairs whose exact length was within\n"
+    "the bounds. Results are written to FILE as JSON, to the standard\n"
+    "output by default.\n");
+  exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const string flag = argv[i];
+    if (i + 1 == argc) {
+      PrintUsageAndExit();
+    }
+    const char* value = argv[++i];
+    if (flag == "--k") {
+      options.k = atoi(value);
+    } else if (flag == "--n") {
+      options.n = atoll(value);
+    } else if (flag == "--pairs") {
+      options.pairs = atoi(value);
+    } else if (flag == "--seed") {
+      options.seed = strtoull(value, nullptr, 10);
+    } else if (flag == "--out") {
+      options.out_path = value;
+    } else {
+      PrintUsageAndExit();
+    }
+  }
+
+  FILE* out = options.out_path != nullptr ? fopen(options.out_path, "w")
+                                          : stdout;
+  if (out == nullptr) {
+    fprintf(stderr, "Can not open %s\n", options.out_path);
+    return 1;
+  }
+
+  const int num_samplings = sizeof(kSamplings) / sizeof(kSamplings[0]);
+  bool first_record = true;
+  fprintf(out, "[\n");
+  for (double p_err : kPerrs) {
+    // Per sampling rate and strided (0) or hashed (1).
+    vector<ErrorSummary> lower_errors(2 * num_samplings);
+    vector<ErrorSummary> estimate_errors(2 * num_samplings);
+    vector<double> seconds(2 * num_samplings, 0);
+    vector<int> within(2 * num_samplings, 0);
+    double exact_seconds = 0;
+    for (int pair = 0; pair < options.pairs; ++pair) {
+      SequenceGenerator generator(options.seed + pair);
+      MutationRates rates;
+      rates.substitution = 0.8 * p_err;
+      rates.insertion = 0.1 * p_err;
+      rates.deletion = 0.1 * p_err;
+      const string a = generator.Random(options.n);
+      const string b = generator.Mutate(a, rates);
+
+      LcskppParams params(options.k);
+      params.engine = LcskppParams::Engine::SPARSE;
+      const Measurement exact = Measure(a, b, params);
+      exact_seconds += exact.seconds;
+      const double length = max<size_t>(1, exact.result.size());
+      for (int i = 0; i < 2 * num_samplings; ++i) {
+        params.row_sampling = kSamplings[i / 2];
+        params.hash_row_sampling = i % 2;
+        const Measurement sampled = Measure(a, b, params);
+        seconds[i] += sampled.seconds;
+        lower_errors[i].Add(sampled.result.size() / length - 1);
+        estimate_errors[i].Add(sampled.result.estimated_size / length - 1);
+        within[i] += sampled.result.size() <= exact.result.size() &&
+                     (int64_t)exact.result.size() <= sampled.result.upper_bound;
+      }
+    }
+
+    for (int i = 0; i < 2 * num_samplings; ++i) {
+      const char* sampling = i % 2 ? "hashed" : "strided";
+      const double speedup = exact_seconds / seconds[i];
+      fprintf(stderr,
+              "p_err=%-5g s=%-3d %-8s speedup %5.2f  lower %+.4f  "
+              "estimate %+.4f +- %.4f (max %.4f)\n",
+              p_err, kSamplings[i / 2], sampling, speedup,
+              lower_errors[i].mean(), estimate_errors[i].mean(),
+              estimate_errors[i].stddev(), estimate_errors[i].max_abs);
+      fprintf(out,
+              "%s  {\"p_err\": %g, \"k\": %d, \"n\": %lld, \"pairs\": %d, "
+              "\"row_sampling\": %d, \"sampling\": \"%s\", "
+              "\"speedup\": %.3f, \"lower_error_mean\": %.6f, "
+              "\"lower_error_stddev\": %.6f, \"estimate_error_mean\": %.6f, "
+              "\"estimate_error_stddev\": %.6f, "
+              "\"estimate_error_max_abs\": %.6f, \"within_bounds\": %.3f}",
+              first_record ? "" : ",\n", p_err, options.k, options.n,
+              options.pairs, kSamplings[i / 2], sampling, speedup,
+              lower_errors[i].mean(), lower_errors[i].stddev(),
+              estimate_errors[i].mean(), estimate_errors[i].stddev(),
+              estimate_errors[i].max_abs,
+              (double)within[i] / options.pairs);
+      first_record = false;
+    }
+  }
+  fprintf(out, "\n]\n");
+  if (out != stdout) fclose(out);
+  return 0;
+}
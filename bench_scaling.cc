@@ -0,0 +1,275 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// End-to-end scaling benchmark of LcskppSparseFast. Every mode, with and
+// without reverse, is run on inputs of growing length and for every run the
+// time, peak RSS, number of matches and length of the reconstruction are
+// recorded. Between consecutive lengths the growth exponent of the time is
+// compared with the expected one, drifts are reported.
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "fast_simple_lcsk/lcsk.h"
+#include "util/sequence_generator.h"
+#include "util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+struct Options {
+  int k = 14;
+  long long min_n = 1000;
+  long long max_n = 100000;
+  double p_err = 0.05;
+  uint64_t seed = 1603;
+  // Larger inputs of a series are skipped once a run took longer.
+  double max_seconds = 60;
+  // Time is expected to grow as n^expected_exponent, within the tolerance.
+  double expected_exponent = 1.0;
+  double tolerance = 0.35;
+  // Runs faster than this are too noisy for the growth exponent.
+  double min_seconds_for_exponent = 0.02;
+  const char* out_path = nullptr;
+};
+
+enum InputType { RANDOM, MUTATED, REPEAT_RICH };
+const char* const kInputNames[] = {"random", "mutated", "repeat_rich"};
+
+struct Mode {
+  const char* name;
+  LcskppParams::Mode mode;
+};
+const Mode kModes[] = {
+    {"LCSKPP", LcskppParams::Mode::SINGLESTART},
+    {"MS", LcskppParams::Mode::MULTISTART_2D_LOGARITHMIC},
+    {"MSA", LcskppParams::Mode::MULTISTART_AGGRESSIVE},
+};
+
+// What a run reports back to the driver.
+struct Measurement {
+  double seconds;
+  unsigned long long num_matches;
+  unsigned long long length;
+};
+
+struct Run {
+  long long n;
+  bool ok;
+  Measurement measurement;
+  long long max_rss_kb;
+  double exponent;
+  bool drift;
+};
+
+void GenerateInputs(InputType type, long long n, const Options& options,
+                    string* a, string* b) {
+  SequenceGenerator generator(options.seed + n * 3 + type);
+  // Mutated copies get a tenth of the mutations as insertions and as
+  // deletions.
+  MutationRates rates;
+  rates.substitution = 0.8 * options.p_err;
+  rates.insertion = 0.1 * options.p_err;
+  rates.deletion = 0.1 * options.p_err;
+  switch (type) {
+    case RANDOM:
+      *a = generator.Random(n);
+      *b = generator.Random(n);
+      break;
+    case MUTATED:
+      *a = generator.Random(n);
+      *b = generator.Mutate(*a, rates);
+      break;
+    case REPEAT_RICH:
+      // About half of the sequence is covered by segmental duplications,
+      // diverged by 5%, and some of it by tandem repeats.
+      *a = generator.Random(n);
+      generator.AddSegmentalDuplications(a, n / 2000, 1000, 0.05);
+      generator.AddTandemRepeats(a, n / 10000 + 1, 20, 25);
+      *b = generator.Mutate(*a, rates);
+      break;
+  }
+}
+
+// Runs the comparison in a child process, so its peak RSS is not mixed up
+// with the one of the other runs. The RSS includes the inputs.
+Run RunInChild(const string& a, const string& b, const LcskppParams& params) {
+  Run run = Run();
+  run.n = a.size();
+  int fds[2];
+  if (pipe(fds) != 0) return run;
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    LcskppStats stats;
+    Stopwatch stopwatch;
+    auto result = LcskppSparseFastRuns(a, b, params, &stats);
+    Measurement measurement{stopwatch.Seconds(), stats.num_matches,
+                            result.size()};
+    ssize_t written = write(fds[1], &measurement, sizeof(measurement));
+    _exit(written == sizeof(measurement) ? 0 : 1);
+  }
+  close(fds[1]);
+  if (pid < 0) {
+    close(fds[0]);
+    return run;
+  }
+  run.ok = read(fds[0], &run.measurement, sizeof(run.measurement)) ==
+           sizeof(run.measurement);
+  close(fds[0]);
+  int status;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  run.ok = run.ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  run.max_rss_kb = usage.ru_maxrss;
+  return run;
+}
+
+void PrintUsageAndExit() {
+  printf(
+    "End-to-end scaling benchmark of LcskppSparseFast.\n\n"
+    "Usage: ./bench_scaling [--k K] [--min-n N] [--max-n N] [--p-err P]\n"
+    "                       [--max-seconds S] [--expected-exponent E]\n"
+    "                       [--tolerance T] [--seed SEED] [--out FILE]\n"
+    "Lengths go from --min-n (default 1000) to --max-n (default 100000) in\n"
+    "powers of 10, up to 100000000 is supported. Inputs are random pairs,\n"
+    "mutated copies (mutation rate P, default 0.05, of which a fifth are\n"
+    "indels) and repeat-rich sequences with their mutated copies. Inputs\n"
+    "are generated from SEED (default 1603).\n"
+    "Once a run takes more than S seconds (default 60) the larger lengths\n"
+    "of its series are skipped.\n"
+    "Time is expected to grow as n^E (default 1.0), growth exponents\n"
+    "further than T (default 0.35) from it are reported as drifts.\n"
+    "Results are written to FILE as JSON, to the standard output by "
+    "default.\n");
+  exit(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const string flag = argv[i];
+    if (i + 1 == argc) {
+      PrintUsageAndExit();
+    }
+    const char* value = argv[++i];
+    if (flag == "--k") {
+      options.k = atoi(value);
+    } else if (flag == "--min-n") {
+      options.min_n = atoll(value);
+    } else if (flag == "--max-n") {
+      options.max_n = atoll(value);
+    } else if (flag == "--p-err") {
+      options.p_err = atof(value);
+    } else if (flag == "--max-seconds") {
+      options.max_seconds = atof(value);
+    } else if (flag == "--expected-exponent") {
+      options.expected_exponent = atof(value);
+    } else if (flag == "--tolerance") {
+      options.tolerance = atof(value);
+    } else if (flag == "--seed") {
+      options.seed = strtoull(value, nullptr, 10);
+    } else if (flag == "--out") {
+      options.out_path = value;
+    } else {
+      PrintUsageAndExit();
+    }
+  }
+
+  FILE* out = options.out_path != nullptr ? fopen(options.out_path, "w")
+                                          : stdout;
+  if (out == nullptr) {
+    fprintf(stderr, "Can not open %s\n", options.out_path);
+    return 1;
+  }
+
+  const int kNumSeries = 3 * 3 * 2;
+  // Last run and whether the series is still going, per series.
+  vector<Run> last(kNumSeries);
+  vector<bool> active(kNumSeries, true);
+  int num_drifts = 0;
+  bool first_record = true;
+  fprintf(out, "[\n");
+  for (long long n = options.min_n; n <= options.max_n; n *= 10) {
+    for (int type = RANDOM; type <= REPEAT_RICH; ++type) {
+      string a, b;
+      GenerateInputs((InputType)type, n, options, &a, &b);
+      for (int mode = 0; mode < 3; ++mode) {
+        for (int reverse = 0; reverse < 2; ++reverse) {
+          const int series = (type * 3 + mode) * 2 + reverse;
+          if (!active[series]) continue;
+          LcskppParams params(options.k);
+          params.mode = kModes[mode].mode;
+          params.reverse = reverse;
+          Run run = RunInChild(a, b, params);
+
+          run.exponent = NAN;
+          if (run.ok && last[series].ok &&
+              last[series].measurement.seconds >=
+                  options.min_seconds_for_exponent) {
+            run.exponent = log(run.measurement.seconds /
+                               last[series].measurement.seconds) /
+                           log((double)run.n / last[series].n);
+            run.drift = fabs(run.exponent - options.expected_exponent) >
+                        options.tolerance;
+            num_drifts += run.drift;
+          }
+          active[series] =
+              run.ok && run.measurement.seconds <= options.max_seconds;
+          last[series] = run;
+
+          fprintf(stderr, "%-12s %-6s reverse=%d n=%-10lld %s",
+                  kInputNames[type], kModes[mode].name, reverse, n,
+                  run.ok ? "" : "FAILED\n");
+          if (!run.ok) continue;
+          fprintf(stderr, "%9.3fs %8lld KB exponent %5.2f%s\n",
+                  run.measurement.seconds, run.max_rss_kb, run.exponent,
+                  run.drift ? " DRIFT" : "");
+          fprintf(out,
+                  "%s  {\"input\": \"%s\", \"mode\": \"%s\", \"reverse\": %s, "
+                  "\"k\": %d, \"n\": %lld, \"seconds\": %.6f, "
+                  "\"max_rss_kb\": %lld, \"num_matches\": %llu, "
+                  "\"length\": %llu, \"growth_exponent\": ",
+                  first_record ? "" : ",\n", kInputNames[type],
+                  kModes[mode].name, reverse ? "true" : "false", options.k,
+                  n, run.measurement.seconds, run.max_rss_kb,
+                  run.measurement.num_matches, run.measurement.length);
+          if (std::isnan(run.exponent)) {
+            fprintf(out, "null, \"drift\": false}");
+          } else {
+            fprintf(out, "%.3f, \"drift\": %s}", run.exponent,
+                    run.drift ? "true" : "false");
+          }
+          first_record = false;
+        }
+      }
+    }
+  }
+  fprintf(out, "\n]\n");
+  if (out != stdout) fclose(out);
+
+  fprintf(stderr, "%d growth rate drift(s) from n^%.2f\n", num_drifts,
+          options.expected_exponent);
+  return 0;
+}
@@ -20,7 +20,6 @@
 #include <unordered_map>
 
 #include "../fast_simple_lcsk/lcsk.h"
-#include "../fast_simple_lcsk/match_pair.h"
 #include "../fast_simple_lcsk/rolling_hasher.h"
 
 using namespace std;
@@ -95,17 +94,18 @@ int main(int argc, char** argv) {
   cerr << "input.size()=" << n << endl;
 
   const long long num_match_pairs = CountMatchPairs(input, k);
-  vector<pair<int, int>> recon;
-  LcsKSparseFast(input, input, k, &recon);
+  LcskppStats stats;
+  auto recon = LcskppSparseFastRuns(input, input, LcskppParams(k), &stats);
 
-  // '+1' comes from a single dummy MatchPair object in the first row of the
-  // compressed table.
-  assert(num_match_pairs + 1 == ObjectCounter<MatchPair>::objects_created);
+  // Every match is a MatchPair, unless it extends the one ending in the
+  // previous row in place.
+  assert(num_match_pairs == stats.num_matches);
+  assert(stats.match_pairs_created <= stats.num_matches);
 
   const int length = recon.size();
   cout << n << " "
        << length << " "
        << num_match_pairs << " "
-       << ObjectCounter<MatchPair>::max_objects_alive << endl;
+       << stats.max_live_match_pairs << endl;
   return 0;
 }
@@ -0,0 +1,70 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef CALL_BUDGET
+#define CALL_BUDGET
+
+#include <cstdint>
+
+#include "lcsk.h"
+#include "../util/stopwatch.h"
+
+// Budget of a single call, as set by LcskppParams::time_budget_seconds,
+// match_budget and cancel_token. Once it expires it stays expired. Not
+// synchronized, it is checked by one thread at a time.
+class CallBudget {
+ public:
+  // The time budget starts running now.
+  explicit CallBudget(const LcskppParams& params)
+      : time_budget_seconds_(params.time_budget_seconds),
+        match_budget_(params.match_budget),
+        cancel_token_(params.cancel_token),
+        limited_(time_budget_seconds_ > 0 || match_budget_ > 0 ||
+                 cancel_token_ != nullptr) {}
+
+  // Called before processing a row with num_matches matches, returns true
+  // if the row should not be processed anymore.
+  bool Expired(uint64_t num_matches = 0) {
+    if (!limited_ || expired_) return expired_;
+    matches_ += num_matches;
+    if (match_budget_ > 0 && matches_ > match_budget_) {
+      expired_ = true;
+    } else if (cancel_token_ != nullptr && cancel_token_->cancelled()) {
+      expired_ = true;
+    } else if (time_budget_seconds_ > 0 && ++checks_ % kChecksPerClock == 0 &&
+               stopwatch_.Seconds() > time_budget_seconds_) {
+      expired_ = true;
+    }
+    return expired_;
+  }
+
+  bool expired() const { return expired_; }
+
+ private:
+  // The clock is read once per this many checks, a row is much cheaper than
+  // reading it.
+  static const int kChecksPerClock = 16;
+
+  const double time_budget_seconds_;
+  const uint64_t match_budget_;
+  const LcskppCancelToken* cancel_token_;
+  const bool limited_;
+  Stopwatch stopwatch_;
+  uint64_t matches_ = 0;
+  uint64_t checks_ = 0;
+  bool expired_ = false;
+};
+
+#endif  // CALL_BUDGET
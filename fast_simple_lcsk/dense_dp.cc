@@ -0,0 +1,208 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "dense_dp.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "sparse_dp.h"
+#include "../util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+typedef unsigned long long Word;
+const int kWordBits = 64;
+
+// Shifts the bit vector of num_words words by one position up.
+inline void ShiftUp(Word* bits, int num_words) {
+  for (int w = num_words - 1; w > 0; --w) {
+    bits[w] = (bits[w] << 1) | (bits[w - 1] >> (kWordBits - 1));
+  }
+  bits[0] <<= 1;
+}
+
+// Sets row[j] = max(prev[j], value) for begin <= j < end.
+inline void RaiseRow(const uint16_t* prev, uint16_t value, int begin, int end,
+                     uint16_t* row) {
+  int j = begin;
+#if defined(__SSE2__)
+  // Values are smaller than 2^15, so the signed maximum works for them.
+  const __m128i values = _mm_set1_epi16(value);
+  for (; j + 8 <= end; j += 8) {
+    const __m128i x = _mm_loadu_si128((const __m128i*)(prev + j));
+    _mm_storeu_si128((__m128i*)(row + j), _mm_max_epi16(x, values));
+  }
+#endif
+  for (; j < end; ++j) {
+    row[j] = max(prev[j], value);
+  }
+}
+
+// Tables of the dense dp. Every thread keeps the ones of its last call:
+// fresh allocations of their size are served by new pages, whose faults
+// would cost more than the dp itself.
+struct DenseTables {
+  vector<uint16_t> dp;
+  vector<uint16_t> run;
+};
+thread_local DenseTables tables;
+
+}  // namespace
+
+bool FitsDense(const string& a, const string& b) {
+  return b.size() <= kMaxDenseCols &&
+         (long long)(a.size() + 1) * (b.size() + 1) <= kMaxDenseCells;
+}
+
+vector<LcskppRun> DenseLcskpp(const string& a, const string& b, const int k,
+                              const bool lcsk_plus, LcskppStats* stats) {
+  assert(FitsDense(a, b));
+  const int n = a.size();
+  const int m = b.size();
+  const int cols = m + 1;
+  const int num_words = max(1, (m + kWordBits - 1) / kWordBits);
+
+  // eq[id[c] * num_words + w] is word w of the bit vector marking the
+  // occurrences of the character c in b. Characters not in b have id 0 and
+  // an empty bit vector.
+  Stopwatch stopwatch;
+  int id[256] = {0};
+  int num_ids = 1;
+  for (char c : b) {
+    if (id[(unsigned char)c] == 0) id[(unsigned char)c] = num_ids++;
+  }
+  vector<Word> eq(num_ids * num_words, 0);
+  for (int j = 0; j < m; ++j) {
+    eq[id[(unsigned char)b[j]] * num_words + j / kWordBits] |=
+        1ULL << (j % kWordBits);
+  }
+  stats->alphabet_seconds += stopwatch.Seconds();
+
+  // dp[i * cols + j] is the LCSk of a[0, i) and b[0, j). For LCSk++
+  // run[i * cols + j] is the best one ending with a run of at least k
+  // characters at a[i - 1] and b[j - 1], and is only set for the cells
+  // which end such a run. Lengths are bounded by kMaxDenseCols, so they fit
+  // 16 bits.
+  if (tables.dp.size() < (size_t)(n + 1) * cols) {
+    tables.dp.resize((n + 1) * cols);
+    tables.run.resize((n + 1) * cols);
+  }
+  uint16_t* dp = tables.dp.data();
+  uint16_t* run = tables.run.data();
+  fill(dp, dp + cols, 0);
+  // ends[(t - 1) * num_words + w] holds word w of E_t of the current row,
+  // for t <= k + 1. E_{k + 1} marks the cells continuing a run of the
+  // previous row.
+  vector<Word> ends((k + 1) * num_words, 0);
+
+  RecordRowMatches(0, stats);
+  stopwatch.Restart();
+  for (int i = 1; i <= n; ++i) {
+    const Word* row_eq = &eq[id[(unsigned char)a[i - 1]] * num_words];
+    for (int t = k + 1; t > 1; --t) {
+      Word* e = &ends[(t - 1) * num_words];
+      copy(e - num_words, e, e);
+      ShiftUp(e, num_words);
+      for (int w = 0; w < num_words; ++w) {
+        e[w] &= row_eq[w];
+      }
+    }
+    copy(row_eq, row_eq + num_words, ends.begin());
+
+    // A match raises the values of its cell and of all of the cells right
+    // of it to at least its own, the rest is taken from the previous row.
+    // Between two matches that is an elementwise maximum with a constant.
+    uint16_t* curr = &dp[i * cols];
+    const uint16_t* prev = &dp[(i - 1) * cols];
+    const Word* match_ends = &ends[(k - 1) * num_words];
+    const Word* continuations = &ends[k * num_words];
+    int num_matches = 0;
+    int filled = 0;
+    uint16_t raised = 0;
+    for (int w = 0; w < num_words; ++w) {
+      for (Word bits = match_ends[w]; bits; bits &= bits - 1) {
+        // Cell (i, j) ends a common substring of length at least k.
+        const int bit = __builtin_ctzll(bits);
+        const int j = w * kWordBits + bit + 1;
+        int best = dp[(i - k) * cols + j - k] + k;
+        if (lcsk_plus) {
+          if ((continuations[w] >> bit) & 1) {
+            best = max(best, run[(i - 1) * cols + j - 1] + 1);
+          }
+          run[i * cols + j] = best;
+        }
+        RaiseRow(prev, raised, filled, j, curr);
+        filled = j;
+        raised = max<int>(raised, best);
+        ++num_matches;
+      }
+    }
+    RaiseRow(prev, raised, filled, cols, curr);
+    RecordRowMatches(num_matches, stats);
+  }
+  stats->dp_seconds += stopwatch.Seconds();
+
+  // Walks back the chain the sparse engine reconstructs, so that both of
+  // them give the same runs. Its best match is, among the cells of a
+  // value, the one in the leftmost column and the topmost row of it: the
+  // first cell where dp reaches the value. A cell continues the run of the
+  // previous one whenever that is at least as good as a new match.
+  stopwatch.Restart();
+  auto first_reaching = [&](int last_row, int value, int* i, int* j) {
+    const uint16_t* row = &dp[last_row * cols];
+    *j = lower_bound(row, row + cols, value) - row;
+    int low = 0;
+    int high = last_row;
+    while (low < high) {
+      const int mid = (low + high) / 2;
+      if (dp[mid * cols + *j] >= value) {
+        high = mid;
+      } else {
+        low = mid + 1;
+      }
+    }
+    *i = low;
+  };
+  vector<LcskppRun> runs;
+  int i = 0;
+  int j = 0;
+  int value = dp[n * cols + m];
+  if (value > 0) first_reaching(n, value, &i, &j);
+  while (value > 0) {
+    if (lcsk_plus && i > k && j > k && a[i - k - 1] == b[j - k - 1] &&
+        run[(i - 1) * cols + j - 1] + 1 == value) {
+      runs.push_back(LcskppRun{i - 1, j - 1, 1, false});
+      --i;
+      --j;
+      --value;
+      continue;
+    }
+    assert(dp[(i - k) * cols + j - k] + k == value);
+    runs.push_back(LcskppRun{i - k, j - k, k, false});
+    value -= k;
+    if (value > 0) first_reaching(i - k, value, &i, &j);
+  }
+  NormalizeRuns(&runs);
+  stats->reconstruction_seconds += stopwatch.Seconds();
+  return runs;
+}
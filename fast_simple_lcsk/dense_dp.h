@@ -0,0 +1,48 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef DENSE_DP
+#define DENSE_DP
+
+#include <string>
+#include <vector>
+
+#include "lcsk.h"
+#include "lcsk_result.h"
+
+// Inputs with at most this many columns (length of b) and cells of the
+// match matrix are small enough for the dense engine.
+const int kMaxDenseCols = 512;
+const long long kMaxDenseCells = 1 << 18;
+
+// True if LCSk of a and b can be computed by DenseLcskpp.
+bool FitsDense(const std::string& a, const std::string& b);
+
+// LCSk (or LCSk++) of a and b computed by the dense dynamic programming over
+// all of the cells of the match matrix, which for short strings is cheaper
+// than building the sparse one.
+//
+// The matches are found bit-parallel: a row of the matrix is a bit vector
+// over b, and the cells ending a common substring of length at least t are
+//   E_t(i) = Eq(a[i]) & (E_{t-1}(i - 1) << 1),
+// where Eq(c) marks the occurrences of c in b. Only the cells in E_k(i) can
+// improve the dp value, the rest of the row is a running maximum of the
+// previous one. Gives the same runs as the sparse engine, statistics of the
+// call are added to stats.
+// The tables (at most 1MB) are kept by the calling thread for its next call.
+std::vector<LcskppRun> DenseLcskpp(const std::string& a, const std::string& b,
+                                   int k, bool lcsk_plus, LcskppStats* stats);
+
+#endif  // DENSE_DP
@@ -0,0 +1,251 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "kmer_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+#include "rolling_hasher.h"
+#include "../util/parallel.h"
+
+using namespace std;
+
+namespace {
+
+// Chunks smaller than this are not worth a thread of their own.
+const int kMinKmersPerChunk = 1 << 16;
+// The radix partition uses this many top bits of the hash, which keeps the
+// partitions small enough to be sorted in cache.
+const int kPartitionBits = 12;
+// Upper bound on the directory size (in bits of the slot index).
+const int kMaxDirectoryBits = 30;
+// Number of lookups between two consecutive stages of a batched lookup.
+const int kPrefetchDistance = 16;
+
+struct Entry {
+  unsigned long long hash;
+  uint32_t position;
+};
+
+// Smallest bits such that 2^bits >= x.
+int CeilLog2(unsigned long long x) {
+  int bits = 0;
+  while (bits < 64 && (1ULL << bits) < x) {
+    ++bits;
+  }
+  return bits;
+}
+
+// Number of bits needed to store any hash of a length k string, i.e. any
+// value smaller than alphabet_size^k.
+int HashBits(int k, int alphabet_size) {
+  unsigned long long hash_mod = 1;
+  for (int i = 0; i < k; ++i) {
+    if (hash_mod > ULLONG_MAX / alphabet_size) return 64;
+    hash_mod *= alphabet_size;
+  }
+  return CeilLog2(hash_mod);
+}
+
+inline void Prefetch(const void* address) {
+#if defined(__GNUC__)
+  __builtin_prefetch(address);
+#endif
+}
+
+}  // namespace
+
+void KmerIndex::Build(const string& s, int k, const vector<char>& char_to_id,
+                      int alphabet_size, int num_threads) {
+  assert(s.size() <= UINT32_MAX);
+  const int64_t n = max<int64_t>(0, (int64_t)s.size() - k + 1);
+  hash_bits_ = n > 0 ? HashBits(k, alphabet_size) : 0;
+  const int dir_bits = min(min(hash_bits_, CeilLog2(n)), kMaxDirectoryBits);
+  const int num_slots = 1 << dir_bits;
+  shift_ = hash_bits_ - dir_bits;
+
+  keys_.clear();
+  offsets_.assign(1, 0);
+  positions_.clear();
+  directory_.assign(num_slots + 1, 0);
+  if (n == 0) return;
+
+  const int num_chunks = max<int64_t>(
+      1, min<int64_t>(ResolveNumThreads(num_threads), n / kMinKmersPerChunk));
+  auto chunk_begin = [&](int chunk) { return n * chunk / num_chunks; };
+
+  // 1) Every chunk gets hashed by its own RollingHasher.
+  vector<unsigned long long> hashes(n);
+  ParallelFor(num_chunks, num_chunks, [&](int chunk) {
+    RollingHasher hasher(s, k, char_to_id, alphabet_size, chunk_begin(chunk));
+    for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      hasher.Next(&hashes[i]);
+    }
+  });
+
+  // 2) Radix partition of the (hash, position) pairs by the top bits of the
+  // hash. Chunks are scattered in order, so positions within a partition
+  // stay sorted.
+  const int part_bits = min(dir_bits, kPartitionBits);
+  const int num_parts = 1 << part_bits;
+  const int part_shift = hash_bits_ - part_bits;
+  auto part_of = [&](unsigned long long hash) {
+    return part_shift >= 64 ? 0 : (int)(hash >> part_shift);
+  };
+
+  // next[chunk * num_parts + part] is the next free slot of the part in the
+  // output, reserved for the chunk.
+  vector<int64_t> next(num_chunks * num_parts, 0);
+  ParallelFor(num_chunks, num_chunks, [&](int chunk) {
+    int64_t* count = &next[chunk * num_parts];
+    for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      ++count[part_of(hashes[i])];
+    }
+  });
+  vector<int64_t> part_begin(num_parts + 1);
+  int64_t total = 0;
+  for (int part = 0; part < num_parts; ++part) {
+    part_begin[part] = total;
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+      int64_t count = next[chunk * num_parts + part];
+      next[chunk * num_parts + part] = total;
+      total += count;
+    }
+  }
+  part_begin[num_parts] = total;
+
+  vector<Entry> entries(n);
+  ParallelFor(num_chunks, num_chunks, [&](int chunk) {
+    int64_t* slot = &next[chunk * num_parts];
+    for (int64_t i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) {
+      entries[slot[part_of(hashes[i])]++] = {hashes[i], (uint32_t)i};
+    }
+  });
+  vector<unsigned long long>().swap(hashes);
+
+  // 3) Partitions are sorted independently and the distinct keys counted.
+  vector<int64_t> key_begin(num_parts + 1, 0);
+  ParallelFor(num_parts, num_chunks, [&](int part) {
+    auto first = entries.begin() + part_begin[part];
+    auto last = entries.begin() + part_begin[part + 1];
+    sort(first, last, [](const Entry& x, const Entry& y) {
+      return x.hash < y.hash || (x.hash == y.hash && x.position < y.position);
+    });
+    int64_t distinct = 0;
+    for (auto it = first; it != last; ++it) {
+      if (it == first || it->hash != (it - 1)->hash) ++distinct;
+    }
+    key_begin[part + 1] = distinct;
+  });
+  for (int part = 0; part < num_parts; ++part) {
+    key_begin[part + 1] += key_begin[part];
+  }
+
+  // 4) Every partition fills its own part of the flat arrays and of the
+  // directory.
+  const int64_t num_keys = key_begin[num_parts];
+  keys_.resize(num_keys);
+  offsets_.resize(num_keys + 1);
+  positions_.resize(n);
+  const int slots_per_part = num_slots >> part_bits;
+  ParallelFor(num_parts, num_chunks, [&](int part) {
+    int64_t key = key_begin[part];
+    for (int64_t i = part_begin[part]; i < part_begin[part + 1]; ++i) {
+      positions_[i] = entries[i].position;
+      if (i == part_begin[part] || entries[i].hash != entries[i - 1].hash) {
+        keys_[key] = entries[i].hash;
+        offsets_[key] = i;
+        ++key;
+      }
+    }
+
+    key = key_begin[part];
+    const unsigned long long first_slot = (unsigned long long)part *
+                                          slots_per_part;
+    for (unsigned long long slot = first_slot;
+         slot < first_slot + slots_per_part; ++slot) {
+      while (key < key_begin[part + 1] && Slot(keys_[key]) < slot) {
+        ++key;
+      }
+      directory_[slot] = key;
+    }
+  });
+  offsets_[num_keys] = n;
+  directory_[num_slots] = num_keys;
+}
+
+bool KmerIndex::Find(unsigned long long hash, const uint32_t** begin,
+                     const uint32_t** end) const {
+  unsigned long long slot = Slot(hash);
+  if (!InDirectory(slot)) return false;
+
+  for (uint32_t key = directory_[slot]; key < directory_[slot + 1]; ++key) {
+    if (keys_[key] == hash) {
+      *begin = positions_.data() + offsets_[key];
+      *end = positions_.data() + offsets_[key + 1];
+      return true;
+    }
+  }
+  return false;
+}
+
+void KmerIndex::FindBatch(const unsigned long long* hashes, int num_hashes,
+                          const uint32_t** begins,
+                          const uint32_t** ends) const {
+  // A lookup goes through three stages, kPrefetchDistance lookups apart:
+  //   1) the directory slot of the hash is prefetched,
+  //   2) the slot is read and the keys and offsets it points to prefetched,
+  //   3) the key is found and the beginning of its positions prefetched.
+  // first_key[i % kPrefetchDistance] passes the slot from 2) to 3).
+  int64_t first_key[kPrefetchDistance];
+  for (int i = 0; i < num_hashes + 2 * kPrefetchDistance; ++i) {
+    const int resolved = i - 2 * kPrefetchDistance;
+    if (resolved >= 0) {
+      const unsigned long long hash = hashes[resolved];
+      begins[resolved] = ends[resolved] = positions_.data();
+      // A negative first key means the slot is out of the directory.
+      const int64_t first = first_key[resolved % kPrefetchDistance];
+      const int64_t last_key = first < 0 ? first : directory_[Slot(hash) + 1];
+      for (int64_t key = first; key < last_key; ++key) {
+        if (keys_[key] == hash) {
+          begins[resolved] = positions_.data() + offsets_[key];
+          ends[resolved] = positions_.data() + offsets_[key + 1];
+          Prefetch(begins[resolved]);
+          break;
+        }
+      }
+    }
+
+    const int slotted = i - kPrefetchDistance;
+    if (slotted >= 0 && slotted < num_hashes) {
+      const unsigned long long slot = Slot(hashes[slotted]);
+      int64_t key = -1;
+      if (InDirectory(slot)) {
+        key = directory_[slot];
+        Prefetch(keys_.data() + key);
+        Prefetch(offsets_.data() + key);
+      }
+      first_key[slotted % kPrefetchDistance] = key;
+    }
+
+    if (i < num_hashes) {
+      const unsigned long long slot = Slot(hashes[i]);
+      if (InDirectory(slot)) {
+        Prefetch(directory_.data() + slot);
+      }
+    }
+  }
+}
@@ -0,0 +1,77 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KMER_INDEX
+#define KMER_INDEX
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A static index from the perfect hashes (as computed by the RollingHasher) of
+// the length k substrings of a string to the positions of those substrings.
+// Positions are stored in 32 bits, so the string has to be shorter than 2^32
+// characters.
+//
+// The index is stored as three flat arrays: the sorted distinct hashes, the
+// offsets of their position lists and the concatenated position lists. The
+// distinct hashes are additionally bucketed by their top bits into a
+// directory, so a lookup inspects a single directory slot and on average
+// about one key.
+class KmerIndex {
+ public:
+  KmerIndex() : hash_bits_(0), shift_(0) {}
+
+  // Indexes all length k substrings of s. The hashes are computed in chunks
+  // of s (overlapping by k - 1 characters) and sorted with a parallel radix
+  // partition, using up to num_threads threads.
+  void Build(const std::string& s, int k, const std::vector<char>& char_to_id,
+             int alphabet_size, int num_threads);
+
+  // Finds the positions of the substrings with the given hash. On success
+  // [*begin, *end) holds them in increasing order.
+  bool Find(unsigned long long hash, const uint32_t** begin,
+            const uint32_t** end) const;
+
+  // Same as calling Find for every one of num_hashes hashes, but the lookups
+  // are software pipelined: the memory needed by the lookups of the hashes
+  // further in the batch is prefetched while the current ones are resolved.
+  // Positions of hashes[i] are stored in [begins[i], ends[i]), which is
+  // empty if the hash is not in the index.
+  void FindBatch(const unsigned long long* hashes, int num_hashes,
+                 const uint32_t** begins, const uint32_t** ends) const;
+
+  // Number of distinct substrings in the index.
+  int64_t num_keys() const { return keys_.size(); }
+
+ private:
+  // Directory slot of a hash.
+  unsigned long long Slot(unsigned long long hash) const {
+    return shift_ >= 64 ? 0 : hash >> shift_;
+  }
+  // True if the keys of the slot are in the directory, i.e. the slot and the
+  // one after it. The largest slot would wrap around in slot + 1.
+  bool InDirectory(unsigned long long slot) const {
+    return slot < directory_.size() && slot + 1 < directory_.size();
+  }
+
+  int hash_bits_;
+  int shift_;
+  std::vector<unsigned long long> keys_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> positions_;
+  std::vector<uint32_t> directory_;
+};
+
+#endif  // KMER_INDEX
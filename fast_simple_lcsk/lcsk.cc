@@ -21,272 +21,300 @@
 #include <vector>
 
 #include <cassert>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 
 #include "lcsk.h"
+#include "call_budget.h"
+#include "dense_dp.h"
 #include "match_events_queue.h"
 #include "match_maker.h"
 #include "match_pair.h"
+#include "match_pipeline.h"
+#include "planner.h"
+#include "reference.h"
+#include "sparse_dp.h"
+#include "wavefront_dp.h"
+#include "../util/parallel.h"
+#include "../util/stopwatch.h"
 using namespace std;
 
 namespace {
 
-vector<pair<int, int>> FillLcskReconstruction(
-    const int k, std::shared_ptr<MatchPair> best) {
-  std::vector<std::pair<int, int>> lcsk_recon;
-
-  for (auto ft = best; ft != nullptr; ft = ft->prev) {
-    int r = ft->end_row;
-    int c = ft->end_col;
-
-    if (ft->prev == nullptr ||
-        (ft->prev->end_row + k <= ft->end_row &&
-         ft->prev->end_col + k <= ft->end_col)) {
-      for (int j = 0; j < k; ++j, --r, --c) {
-        lcsk_recon.push_back(make_pair(r, c));
-      }
-    } else {
-      assert(ft->prev->end_row + 1 == ft->end_row &&
-             ft->prev->end_col + 1 == ft->end_col);
-      lcsk_recon.push_back(make_pair(r, c));
-    }
+// Number of rows for which the matches are generated at once.
+const int kRowsPerBlock = 4096;
+// Number of characters read at once from a streamed string.
+const int kStreamBlockSize = 1 << 16;
+// Number of consecutive windows of a profile a thread computes at once,
+// sliding them over the runs of the strings.
+const int kWindowsPerTask = 64;
+
+// The rows are processed until the budget expires, the reconstruction is the
+// best chain of the rows processed until then.
+template <typename Position>
+vector<LcskppRun> LcskppSparseFastRealImpl(
+    int k, int lcsk_plus, const vector<vector<uint32_t>> &matches,
+    CallBudget* budget, LcskppStats* stats, ObjectCounter* match_pairs) {
+  SparseDp<Position> dp(k, lcsk_plus, stats, match_pairs);
+  Stopwatch stopwatch;
+  for (Position row = 0; row < (Position)matches.size(); ++row) {
+    const vector<uint32_t> &row_matches = matches[row];
+    if (budget->Expired(row_matches.size())) break;
+    dp.ProcessRow(row, row_matches.data(),
+                  row_matches.data() + row_matches.size());
   }
-  reverse(lcsk_recon.begin(), lcsk_recon.end());
-  return lcsk_recon;
+  stats->dp_seconds += stopwatch.Seconds();
+  return dp.Reconstruction();
 }
 
-bool CompareByCol(const std::shared_ptr<MatchPair>& a,
-                  const std::shared_ptr<MatchPair>& b) {
-  return a->end_col < b->end_col;
-}
-
-void RowUpdate(
-    const int k, const int row, MatchEventsQueue* events_ptr,
-    vector<std::shared_ptr<MatchPair>>* compressed_table_ptr,
-    vector<std::shared_ptr<MatchPair>>* prev_row_match_pairs,
-    bool lcsk_plus) {
-  auto& events = *events_ptr;
-  auto& compressed_table = *compressed_table_ptr;
-  auto& prev_row = *prev_row_match_pairs;
-
-  std::tuple<int, int, std::shared_ptr<MatchPair>> event;
-
-  vector<std::shared_ptr<MatchPair>> curr_row;
-  int curr_continuation_index = 0;
-
-  while (events.PopEnd(row, &event)) {
-    int i = get<0>(event);
-    int j = get<1>(event);
-    assert(i == row);
-    auto match_pair_end = get<2>(event);
-
-    if (lcsk_plus) { // LCSk++
-      while (curr_continuation_index < prev_row.size() &&
-             prev_row[curr_continuation_index]->end_col + 1 < match_pair_end->end_col) {
-        curr_continuation_index++;
-      }
-
-      if (curr_continuation_index < prev_row.size() &&
-          prev_row[curr_continuation_index]->end_col + 1 == match_pair_end->end_col) {
-        int continuation_dp = prev_row[curr_continuation_index]->dp + 1;
-        if (continuation_dp > match_pair_end->dp) {
-          match_pair_end->dp = continuation_dp;
-          match_pair_end->prev = prev_row[curr_continuation_index];
-        }
-      }
-
-      curr_row.emplace_back(match_pair_end);
+// Upper bounds of the score a run can still reach, for LcskppParams::
+// min_score.
+template <typename Position>
+class ScoreBound {
+ public:
+  // Counts the matches of every row up front, using up to num_threads
+  // threads.
+  ScoreBound(const PerfectHashMatchMaker& match_maker, Position num_rows,
+             int k, int num_threads)
+      : k_(k), potential_(num_rows + k + 1, 0) {
+    vector<int> counts(num_rows);
+    const int num_blocks = (num_rows + kRowsPerBlock - 1) / kRowsPerBlock;
+    ParallelFor(num_blocks, num_threads, [&](int block) {
+      const Position row_begin = (Position)block * kRowsPerBlock;
+      match_maker.CountMatches(row_begin,
+                               min<Position>(num_rows,
+                                             row_begin + kRowsPerBlock),
+                               counts.data() + row_begin);
+    });
+    // A pair of a chain can be in the row only if a match begins in one of
+    // the k rows ending with it.
+    Position last_match = -k;
+    for (Position row = 0; row < num_rows; ++row) {
+      if (counts[row] > 0) last_match = row;
+      potential_[row] = row - last_match < k;
+    }
+    for (Position row = num_rows - 1; row >= 0; --row) {
+      potential_[row] += potential_[row + 1];
+    }
+  }
 
-      int dp = match_pair_end->dp;
-      while (compressed_table.size() <= dp) {
-        // fill with dummy values which will be overwritten in for loop below anyway.
-        int idx = compressed_table.size();
-        compressed_table.push_back(std::make_shared<MatchPair>(i+1, j+1, idx, nullptr));
-      }
+  // Upper bound of the score of any chain, given that the best chain of the
+  // matches ending above the row scores best. The pairs of a chain above
+  // the row score at most best, apart from the at most k - 1 of a match
+  // crossing the row. Every row from the row on holds at most one pair: the
+  // first k - 1 of them, and after them only the rows a match beginning
+  // from the row on can reach.
+  Position Bound(Position row, Position best) const {
+    return best + 2 * (k_ - 1) + potential_[row + k_ - 1];
+  }
 
-      for (int idx = dp; idx > dp - k && j < compressed_table[idx]->end_col; --idx) {
-        compressed_table[idx] = match_pair_end;
+  // Upper bound of the score of any chain: every pair is in a row of its
+  // own, one of those a match begins in or one of the k - 1 rows after.
+  Position Bound() const { return potential_[0]; }
+
+ private:
+  const int k_;
+  // potential_[row] is the number of rows from row on in which a match
+  // begins or one of the k - 1 rows before.
+  vector<Position> potential_;
+};
+
+// Same as above, but the matches are consumed from the pipeline while they
+// are being generated. Unless band_width is negative they are all in the
+// band of diagonals. If bound is not null, the rows are processed until
+// the best chain reaches min_score or the bound falls below it, stats->partial
+// is set then.
+template <typename Position>
+vector<LcskppRun> LcskppSparseFastRealImpl(
+    int k, int lcsk_plus, MatchPipeline* pipeline, Position band_offset,
+    Position band_width, const ScoreBound<Position>* bound, int min_score,
+    CallBudget* budget, LcskppStats* stats, ObjectCounter* match_pairs) {
+  SparseDp<Position> dp(k, lcsk_plus, stats, match_pairs);
+  if (band_width >= 0) {
+    dp.set_band(band_offset, band_width);
+  }
+  bool stopped = false;
+  while (!stopped) {
+    const MatchesBlock* block = pipeline->Next();
+    if (block == nullptr) break;
+    Stopwatch stopwatch;
+    for (Position row = block->row_begin; row < block->row_end; ++row) {
+      const uint32_t* cols = block->cols.data();
+      const int i = row - block->row_begin;
+      const int num_matches = block->offsets[i + 1] - block->offsets[i];
+      if (bound != nullptr &&
+          (dp.best_score() >= min_score ||
+           bound->Bound(row, dp.best_score()) < min_score)) {
+        stopped = stats->partial = true;
+        break;
       }
-    } else { // LCSk
-      int idx = match_pair_end->dp / k;
-      if (idx == compressed_table.size()) {
-        compressed_table.emplace_back(match_pair_end);
-      } else if (j < compressed_table[idx]->end_col) {
-        compressed_table[idx] = match_pair_end;
+      if (budget->Expired(num_matches)) {
+        stopped = true;
+        break;
       }
+      RecordRowMatches(num_matches, stats);
+      dp.ProcessRow(row, cols + block->offsets[i],
+                    cols + block->offsets[i + 1]);
     }
+    stats->dp_seconds += stopwatch.Seconds();
   }
-
-  prev_row.swap(curr_row);
+  // The producers may still be generating blocks past a stop.
+  pipeline->Stop();
+  stats->match_generation_seconds += pipeline->generation_seconds();
+  return dp.Reconstruction();
 }
 
-void AmortizedRowQuery(
-    const int k, const int row, MatchEventsQueue* events_ptr,
-    vector<std::shared_ptr<MatchPair>>* compressed_table_ptr) {
-  auto& events = *events_ptr;
-  auto& compressed_table = *compressed_table_ptr;
-
-  int curr_threshold_index = 0;
-  std::tuple<int, int, std::shared_ptr<MatchPair>> event;
-
-  while (events.PopBegin(row, &event)) {
-    int i = get<0>(event);
-    int j = get<1>(event);
-    assert(i == row);
-    while (curr_threshold_index < compressed_table.size() &&
-           compressed_table[curr_threshold_index]->end_col < j) {
-      ++curr_threshold_index;
-    }
-
-    auto prev_best = compressed_table[curr_threshold_index - 1];
-    auto match_pair = std::make_shared<MatchPair>(i + k - 1, j + k - 1, k, nullptr);
-    if (prev_best->dp > 0) {
-      match_pair->dp = prev_best->dp + k;
-      match_pair->prev = prev_best;
-    }
-    events.AddEnd(make_tuple(i + k - 1, j + k - 1, match_pair));
+template <typename Position>
+vector<LcskppRun> LcskppSparseFastImpl(const std::string &a,
+                                       const std::string &b,
+                                       int k,
+                                       int lcsk_plus,
+                                       LcskppParams::Mode mode,
+                                       int aggressive_runs,
+                                       int num_threads,
+                                       LcskppParams::Engine engine,
+                                       int band_offset,
+                                       int band_width,
+                                       int min_score,
+                                       int row_sampling,
+                                       bool hash_row_sampling,
+                                       int64_t* upper_bound,
+                                       CallBudget* budget,
+                                       LcskppStats* stats,
+                                       ObjectCounter* match_pairs) {
+  if (budget->Expired()) return {};
+  if (engine == LcskppParams::Engine::DENSE) {
+    assert(mode == LcskppParams::Mode::SINGLESTART);
+    return DenseLcskpp(a, b, k, lcsk_plus, stats);
   }
-}
 
-void ElementwiseRowQuery(
-    const int k, const int row, MatchEventsQueue* events_ptr,
-    vector<std::shared_ptr<MatchPair>>* compressed_table_ptr) {
-  auto& events = *events_ptr;
-  auto& compressed_table = *compressed_table_ptr;
-
-  tuple<int, int, std::shared_ptr<MatchPair>> event;
-
-  while (events.PopBegin(row, &event)) {
-    int i = get<0>(event);
-    int j = get<1>(event);
-    assert(i == row);
-
-    auto dummy_match_pair = std::make_shared<MatchPair>(0, j, 0, nullptr);
-    auto prev_best =
-      lower_bound(compressed_table.begin(), compressed_table.end(),
-                  dummy_match_pair, CompareByCol) -
-      1;
-    // We reuse dummy_match_pair in order to keep the object counters precise
-    // (otherwise the objects_created counter would roughly double due to
-    // instantiation of the dummy object).
-    //
-    // The following several lines can be read as:
-    // auto match_pair =
-    //    std::make_shared<MatchPair>(i + k - 1, j + k - 1, k, nullptr);
-    auto match_pair = dummy_match_pair;
-    match_pair->end_row = i + k - 1;
-    match_pair->end_col = j + k - 1;
-    match_pair->dp = k;
-
-    if ((*prev_best)->dp > 0) {
-      match_pair->dp = (*prev_best)->dp + k;
-      match_pair->prev = *prev_best;
-    }
-    events.AddEnd(make_tuple(i + k - 1, j + k - 1, match_pair));
+  num_threads = ResolveNumThreads(num_threads);
+  PerfectHashMatchMaker match_maker(a, b, k, num_threads);
+  stats->alphabet_seconds += match_maker.alphabet_seconds();
+  stats->index_seconds += match_maker.index_seconds();
+  if (engine == LcskppParams::Engine::BANDED) {
+    assert(mode == LcskppParams::Mode::SINGLESTART && band_width >= 0);
+    match_maker.SetBand(band_offset, band_width);
+  } else {
+    band_width = -1;
   }
-}
-
-vector<pair<int, int>> LcskppSparseFastRealImpl(
-    int k, int lcsk_plus, const vector<vector<int>> &matches) {
-  MatchEventsQueue events;
-  vector<std::shared_ptr<MatchPair>> compressed_table;
-  compressed_table.emplace_back(std::make_shared<MatchPair>(-1, -1, 0, nullptr));
-  // following invariants hold:
-  //    LCSk++: compressed_table[i]->dp == i
-  //    LCSk:   compressed_table[i]->dp == k*i
-  vector<std::shared_ptr<MatchPair>> prev_row_match_pairs;
-
-  for (int row = 0; row < matches.size(); ++row) {
-    const vector<int> &row_matches = matches[row];
-    for (int col : row_matches) {
-      events.AddBegin(make_tuple(row, col, nullptr));
-    }
-
-    int table_row_size = compressed_table.size();
-    int num_begin_events = row_matches.size();
-    bool use_amortized_row_update = (table_row_size + num_begin_events <
-                                     6 * num_begin_events * log(table_row_size) / log(2));
-
-    if (use_amortized_row_update) {
-      AmortizedRowQuery(k, row, &events, &compressed_table);
-    } else {
-      ElementwiseRowQuery(k, row, &events, &compressed_table);
-    }
-
-    RowUpdate(k, row, &events, &compressed_table, &prev_row_match_pairs, lcsk_plus);
+  unique_ptr<ScoreBound<Position>> bound;
+  if (mode == LcskppParams::Mode::SINGLESTART && min_score > 0) {
+    Stopwatch stopwatch;
+    bound.reset(new ScoreBound<Position>(match_maker, a.size() + 1, k,
+                                         num_threads));
+    stats->match_generation_seconds += stopwatch.Seconds();
+  }
+  if (row_sampling > 1) {
+    assert(mode == LcskppParams::Mode::SINGLESTART && band_width < 0 &&
+           bound == nullptr);
+    // The upper bound needs the matches of all of the rows, they are only
+    // counted.
+    Stopwatch stopwatch;
+    *upper_bound =
+        ScoreBound<Position>(match_maker, a.size() + 1, k, num_threads)
+            .Bound();
+    stats->match_generation_seconds += stopwatch.Seconds();
+    match_maker.SetRowSampling(row_sampling, hash_row_sampling);
+  }
+  // Single runs over all of the columns split the threads between the
+  // match generation and the stripes of the wavefront dp. Runs with a
+  // min_score are checked row by row, so they have a single stripe.
+  const int num_stripes =
+      mode == LcskppParams::Mode::SINGLESTART && band_width < 0 &&
+              bound == nullptr
+          ? NumWavefrontStripes(b.size(), k, num_threads)
+          : 1;
+  MatchPipeline pipeline(match_maker, a.size() + 1, kRowsPerBlock,
+                         num_threads - num_stripes + 1);
+  if (num_stripes > 1) {
+    return WavefrontLcskpp<Position>(k, lcsk_plus, b.size(), num_stripes,
+                                     &pipeline, budget, stats, match_pairs);
+  }
+  if (mode == LcskppParams::Mode::SINGLESTART) {
+    return LcskppSparseFastRealImpl<Position>(
+        k, lcsk_plus, &pipeline, band_offset, band_width, bound.get(),
+        min_score, budget, stats, match_pairs);
   }
 
-  auto best = compressed_table.back()->end_row != -1 ? compressed_table.back() : nullptr;
-  return FillLcskReconstruction(k, best);
-}
-
-vector<pair<int, int>> LcskppSparseFastImpl(const std::string &a,
-                                            const std::string &b,
-                                            int k,
-                                            int lcsk_plus,
-                                            LcskppParams::Mode mode,
-                                            int aggressive_runs) {
-  auto match_maker = MatchMaker::Create(a, b, k, PERFECT_HASH);
-  vector<vector<int>> rows_matches;
-  vector<pair<int, int>> matches;
-
-  for (int row = 0; row <= a.size(); ++row) {
-    vector<int> row_matches;
-    match_maker->GetNextMatches(&row_matches);
-    rows_matches.push_back(row_matches);
-    for (int col : row_matches) {
-      matches.emplace_back(row, col);
+  // Multistart modes need all of the matches up front. Generating them is
+  // not part of the budget.
+  vector<pair<Position, uint32_t>> matches;
+  while (const MatchesBlock* block = pipeline.Next()) {
+    for (Position row = block->row_begin; row < block->row_end; ++row) {
+      const int i = row - block->row_begin;
+      RecordRowMatches(block->offsets[i + 1] - block->offsets[i], stats);
+      for (int j = block->offsets[i]; j < block->offsets[i + 1]; ++j) {
+        matches.emplace_back(row, block->cols[j]);
+      }
     }
   }
+  stats->match_generation_seconds += pipeline.generation_seconds();
 
-  vector<pair<int, int>> recon;
+  // Everything but the dp runs themselves is merging.
+  Stopwatch merge_stopwatch;
+  const double dp_seconds_before =
+      stats->dp_seconds + stats->reconstruction_seconds;
+  vector<LcskppRun> recon;
   switch (mode) {
     case LcskppParams::Mode::SINGLESTART: {
-      recon = LcskppSparseFastRealImpl(k, lcsk_plus, rows_matches);
+      // Handled above.
       break;
     }
 
     case LcskppParams::Mode::MULTISTART_2D_LOGARITHMIC: {
-      while (matches.size()) {
+      while (matches.size() && !budget->Expired()) {
         auto cm_matches = matches;
-        sort(cm_matches.begin(), cm_matches.end(), [](pair<int, int> a, pair<int, int> b) {
+        sort(cm_matches.begin(), cm_matches.end(),
+             [](pair<Position, uint32_t> a, pair<Position, uint32_t> b) {
             if (a.second != b.second) return a.second < b.second;
             return a.first < b.first;
         });
-        while (cm_matches.size()) {
-          vector<vector<int>> normalised_matches(a.size() + 1);
+        while (cm_matches.size() && !budget->Expired()) {
+          vector<vector<uint32_t>> normalised_matches(a.size() + 1);
           for (auto match : cm_matches) {
             normalised_matches[match.first].push_back(match.second);
           }
-          auto new_recon = LcskppSparseFastRealImpl(k, lcsk_plus, normalised_matches);
+          auto new_recon = LcskppSparseFastRealImpl<Position>(
+              k, lcsk_plus, normalised_matches, budget, stats, match_pairs);
           recon.insert(recon.end(), new_recon.begin(), new_recon.end());
-          vector<pair<int, int>> new_matches(cm_matches.begin() + (cm_matches.size() + 1) / 2,
-                                             cm_matches.end());
+          vector<pair<Position, uint32_t>> new_matches(
+              cm_matches.begin() + (cm_matches.size() + 1) / 2,
+              cm_matches.end());
           cm_matches = new_matches;
         }
-        vector<pair<int, int>> new_matches(matches.begin() + (matches.size() + 1) / 2,
-                                           matches.end());
+        vector<pair<Position, uint32_t>> new_matches(
+            matches.begin() + (matches.size() + 1) / 2, matches.end());
         matches = new_matches;
       }
       break;
     }
 
     case LcskppParams::Mode::MULTISTART_AGGRESSIVE: {
-      for (int i = 0; i < aggressive_runs; ++i) {
-        vector<vector<int>> normalised_matches(a.size() + 1);
+      for (int i = 0; i < aggressive_runs && !budget->Expired(); ++i) {
+        vector<vector<uint32_t>> normalised_matches(a.size() + 1);
         for (auto match : matches) {
           normalised_matches[match.first].push_back(match.second);
         }
-        auto new_recon = LcskppSparseFastRealImpl(k, lcsk_plus, normalised_matches);
+        auto new_recon = LcskppSparseFastRealImpl<Position>(
+            k, lcsk_plus, normalised_matches, budget, stats, match_pairs);
         recon.insert(recon.end(), new_recon.begin(), new_recon.end());
-        int j = 0;
-        vector<pair<int, int>> new_matches;
+        // Runs of a single reconstruction do not overlap, so its pairs
+        // come out of the iterator sorted.
+        LcskppResult new_result;
+        new_result.runs = new_recon;
+        // end() counts the pairs of the runs, it is built once.
+        auto j = new_result.begin();
+        const auto end = new_result.end();
+        vector<pair<Position, uint32_t>> new_matches;
         for (auto match : matches) {
-          while (j < new_recon.size() && new_recon[j] < match) {
+          const LcskppResult::const_iterator::value_type pair = match;
+          while (j != end && *j < pair) {
             ++j;
           }
-          if (j == new_recon.size() || new_recon[j] != match) {
+          if (j == end || *j != pair) {
             new_matches.push_back(match);
           }
         }
@@ -296,8 +324,371 @@ vector<pair<int, int>> LcskppSparseFastImpl(const std::string &a,
     }
   }
 
-  sort(recon.begin(), recon.end());
-  recon.erase(unique(recon.begin(), recon.end()), recon.end());
+  NormalizeRuns(&recon);
+  stats->merge_seconds +=
+      merge_stopwatch.Seconds() -
+      (stats->dp_seconds + stats->reconstruction_seconds - dp_seconds_before);
+  return recon;
+}
+
+// Processes the rows [first_row, first_row + hashes.size()) of the stream
+// given the hashes of their length k substrings, until the budget expires.
+template <typename Position>
+void ProcessStreamedRows(const KmerIndex& index,
+                         const vector<unsigned long long>& hashes,
+                         Position first_row, SparseDp<Position>* dp,
+                         CallBudget* budget, LcskppStats* stats) {
+  Stopwatch stopwatch;
+  vector<const uint32_t*> begins(hashes.size());
+  vector<const uint32_t*> ends(hashes.size());
+  index.FindBatch(hashes.data(), hashes.size(), begins.data(), ends.data());
+  stats->match_generation_seconds += stopwatch.Seconds();
+
+  stopwatch.Restart();
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    if (budget->Expired(ends[i] - begins[i])) break;
+    RecordRowMatches(ends[i] - begins[i], stats);
+    dp->ProcessRow(first_row + i, begins[i], ends[i]);
+  }
+  stats->dp_seconds += stopwatch.Seconds();
+}
+
+// True if 32-bit positions do not fit strings at most max_length long.
+// Besides the positions themselves, the dp computes positions up to 2k past
+// them.
+bool LongStrings(int64_t max_length, int k) {
+  return max_length + 2LL * k >= INT_MAX;
+}
+
+// True if the positions of a call on strings at most max_length long are
+// 64-bit, see LcskppParams::position_bits.
+bool LargePositions(int64_t max_length, const LcskppParams& params) {
+  if (params.position_bits != 0) return params.position_bits == 64;
+  return LongStrings(max_length, params.k);
+}
+
+// Estimated LCSk++ length of a run which sampled the rows of a (see
+// LcskppParams::row_sampling), from the chain of sampled matches it found.
+// The chain takes the runs of the LCSk++ apart into the length k matches
+// beginning in sampled rows, about one per m rows: s * ceil(k / s) for
+// strided samples and k + s - 1 for hashed ones. Matches less than m rows
+// apart on a diagonal are taken to be a single run of the LCSk++, with the
+// rows between them matched too, and which had on average (s - 1) / 2 (s - 1
+// for hashed samples) rows before its first match and (m - 1) / 2 after its
+// last one. Runs of the LCSk++ too short to hold a sampled match are not
+// accounted for. The estimate is kept between the length of the chain and
+// upper_bound.
+double EstimateSampledSize(const vector<LcskppRun>& recon,
+                           const LcskppParams& params, int64_t upper_bound) {
+  const int k = params.k;
+  const int s = params.row_sampling;
+  const bool by_hash = params.hash_row_sampling;
+  const int m = by_hash ? k + s - 1 : s * ((k + s - 1) / s);
+  const double head = by_hash ? s - 1 : (s - 1) / 2.0;
+  const double tail = (m - 1) / 2.0;
+  double estimate = 0;
+  int64_t chain_size = 0;
+  int64_t span = 0;
+  // The runs of a single run's reconstruction are sorted and not reversed.
+  for (size_t i = 0; i < recon.size(); ++i) {
+    chain_size += recon[i].length;
+    const bool continues =
+        i > 0 &&
+        recon[i].b_start - recon[i].a_start ==
+            recon[i - 1].b_start - recon[i - 1].a_start &&
+        recon[i].a_start - (recon[i - 1].a_start + recon[i - 1].length) < m;
+    if (continues) {
+      span += recon[i].a_start + recon[i].length -
+              (recon[i - 1].a_start + recon[i - 1].length);
+    } else {
+      span = recon[i].length;
+    }
+    const bool last = i + 1 == recon.size() ||
+                      recon[i + 1].b_start - recon[i + 1].a_start !=
+                          recon[i].b_start - recon[i].a_start ||
+                      recon[i + 1].a_start -
+                              (recon[i].a_start + recon[i].length) >=
+                          m;
+    if (last) estimate += head + span + tail;
+  }
+  return max<double>(chain_size, min<double>(estimate, upper_bound));
+}
+
+// Merges the reconstruction computed against reversed b into recon.
+void MergeReverseReconstruction(int64_t b_len,
+                                const vector<LcskppRun>& recon_reverse,
+                                vector<LcskppRun>* recon,
+                                LcskppStats* stats) {
+  Stopwatch stopwatch;
+  for (const auto& run : recon_reverse) {
+    recon->push_back(
+        LcskppRun{run.a_start, b_len - 1 - run.b_start, run.length, true});
+  }
+  NormalizeRuns(recon);
+  stats->merge_seconds += stopwatch.Seconds();
+}
+
+// Adds the match generation and dp statistics of a part of the call, which
+// had stats of its own, to stats.
+void AddDpStats(const LcskppStats& some_stats, LcskppStats* stats) {
+  stats->match_generation_seconds += some_stats.match_generation_seconds;
+  stats->dp_seconds += some_stats.dp_seconds;
+  stats->reconstruction_seconds += some_stats.reconstruction_seconds;
+  stats->num_matches += some_stats.num_matches;
+  const auto& histogram = some_stats.row_match_histogram;
+  if (stats->row_match_histogram.size() < histogram.size()) {
+    stats->row_match_histogram.resize(histogram.size());
+  }
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    stats->row_match_histogram[i] += histogram[i];
+  }
+  stats->compressed_table_size =
+      max(stats->compressed_table_size, some_stats.compressed_table_size);
+  stats->amortized_rows += some_stats.amortized_rows;
+  stats->elementwise_rows += some_stats.elementwise_rows;
+}
+
+// Computes the dp of every k of ks (sorted and distinct) against b, each k
+// with budgets[i] and stats of its own which are then added to stats, see
+// LcskppSparseFastSweep.
+vector<vector<LcskppRun>> LcskppSweepImpl(const string& a, const string& b,
+                                          const vector<int>& ks,
+                                          int lcsk_plus, int num_threads,
+                                          vector<CallBudget>* budgets,
+                                          LcskppStats* stats,
+                                          ObjectCounter* match_pairs) {
+  num_threads = ResolveNumThreads(num_threads);
+  PerfectHashMatchMaker match_maker(a, b, ks[0], num_threads);
+  stats->alphabet_seconds += match_maker.alphabet_seconds();
+  stats->index_seconds += match_maker.index_seconds();
+  Stopwatch stopwatch;
+  const vector<DiagonalRun> runs =
+      FindDiagonalRuns(match_maker, a, b, ks[0], num_threads);
+  stats->match_generation_seconds += stopwatch.Seconds();
+
+  vector<vector<LcskppRun>> recons(ks.size());
+  vector<LcskppStats> k_stats(ks.size());
+  ParallelFor(ks.size(), num_threads, [&](int i) {
+    RunsMatchMaker runs_match_maker(runs, ks[i], a.size());
+    MatchPipeline pipeline(runs_match_maker, a.size() + 1, kRowsPerBlock, 1);
+    recons[i] = LcskppSparseFastRealImpl<int>(ks[i], lcsk_plus, &pipeline, 0,
+                                              -1, nullptr, 0, &(*budgets)[i],
+                                              &k_stats[i], match_pairs);
+  });
+
+  for (const auto& some_stats : k_stats) {
+    AddDpStats(some_stats, stats);
+  }
+  return recons;
+}
+
+// Part of the run in the rows [row_begin, row_end) and the columns
+// [col_begin, col_end), relative to them. Its length is not positive if
+// there is none.
+DiagonalRun ClipRun(const DiagonalRun& run, int row_begin, int row_end,
+                    int col_begin, int col_end) {
+  const int64_t diagonal = (int64_t)run.col - run.row;
+  const int64_t first =
+      max<int64_t>(max(run.row, row_begin), col_begin - diagonal);
+  const int64_t last = min<int64_t>(min(run.row + run.length, row_end),
+                                    col_end - diagonal);
+  return {(int)(first - row_begin), (int)(first + diagonal - col_begin),
+          (int)max<int64_t>(last - first, 0)};
+}
+
+// Adds the LCSk++ length of the windows of a and b to scores, see
+// LcskppSparseFastProfile. If reverse is set b was reversed by the caller
+// and the windows of b are mirrored. A window whose budget expired is
+// marked in partial.
+void LcskppProfileImpl(const string& a, const string& b, bool reverse,
+                       int window, int stride, const LcskppParams& params,
+                       const Stopwatch& call_stopwatch, vector<int>* scores,
+                       vector<char>* partial, LcskppStats* stats,
+                       ObjectCounter* match_pairs) {
+  const int k = params.k;
+  const int num_threads = ResolveNumThreads(params.num_threads);
+  const int num_windows = scores->size();
+  PerfectHashMatchMaker match_maker(a, b, k, num_threads);
+  stats->alphabet_seconds += match_maker.alphabet_seconds();
+  stats->index_seconds += match_maker.index_seconds();
+  Stopwatch stopwatch;
+  const vector<DiagonalRun> runs =
+      FindDiagonalRuns(match_maker, a, b, k, num_threads);
+
+  // Consecutive windows are handed out together, task_runs[i] holds the
+  // runs (sorted by row) reaching into the rows of the windows of task i.
+  const int num_tasks = (num_windows + kWindowsPerTask - 1) / kWindowsPerTask;
+  const int64_t task_rows = (int64_t)kWindowsPerTask * stride;
+  const int64_t task_reach = task_rows - stride + window;
+  vector<vector<int>> task_runs(num_tasks);
+  for (int i = 0; i < (int)runs.size(); ++i) {
+    const int64_t end = (int64_t)runs[i].row + runs[i].length;
+    const int64_t first = max<int64_t>(0, (runs[i].row - task_reach) /
+                                              task_rows);
+    const int64_t last = min<int64_t>(num_tasks - 1, (end - 1) / task_rows);
+    for (int64_t task = first; task <= last; ++task) {
+      task_runs[task].push_back(i);
+    }
+  }
+  stats->match_generation_seconds += stopwatch.Seconds();
+
+  vector<LcskppStats> task_stats(num_tasks);
+  ParallelFor(num_tasks, num_threads, [&](int task) {
+    // The window slides over the runs of the task: active holds the ones
+    // which began above its last row and did not end above its first one.
+    const vector<int>& some_runs = task_runs[task];
+    vector<int> active;
+    size_t next = 0;
+    vector<DiagonalRun> window_runs;
+    const int last_window =
+        min(num_windows, (task + 1) * kWindowsPerTask);
+    for (int i = task * kWindowsPerTask; i < last_window; ++i) {
+      const int64_t start = (int64_t)i * stride;
+      const int row_begin = min<int64_t>(start, a.size());
+      const int row_end = min<int64_t>(start + window, a.size());
+      int col_begin = min<int64_t>(start, b.size());
+      int col_end = min<int64_t>(start + window, b.size());
+      if (reverse) {
+        swap(col_begin, col_end);
+        col_begin = b.size() - col_begin;
+        col_end = b.size() - col_end;
+      }
+      while (next < some_runs.size() && runs[some_runs[next]].row < row_end) {
+        active.push_back(some_runs[next++]);
+      }
+      active.erase(remove_if(active.begin(), active.end(),
+                             [&](int j) {
+                               return runs[j].row + runs[j].length <=
+                                      row_begin;
+                             }),
+                   active.end());
+
+      Stopwatch clip_stopwatch;
+      window_runs.clear();
+      for (int j : active) {
+        const DiagonalRun run =
+            ClipRun(runs[j], row_begin, row_end, col_begin, col_end);
+        if (run.length >= k) window_runs.push_back(run);
+      }
+      sort(window_runs.begin(), window_runs.end(),
+           [](const DiagonalRun& x, const DiagonalRun& y) {
+             return make_pair(x.row, x.col) < make_pair(y.row, y.col);
+           });
+      task_stats[task].match_generation_seconds += clip_stopwatch.Seconds();
+      if (window_runs.empty()) continue;
+
+      // The time budget and the cancel token are the ones of the call.
+      LcskppParams window_params = params;
+      if (params.time_budget_seconds > 0) {
+        window_params.time_budget_seconds =
+            params.time_budget_seconds - call_stopwatch.Seconds();
+        if (window_params.time_budget_seconds <= 0) {
+          (*partial)[i] = true;
+          continue;
+        }
+      }
+      CallBudget budget(window_params);
+      RunsMatchMaker window_match_maker(window_runs, k, row_end - row_begin);
+      MatchPipeline pipeline(window_match_maker, row_end - row_begin + 1,
+                             kRowsPerBlock, 1);
+      const vector<LcskppRun> recon = LcskppSparseFastRealImpl<int>(
+          k, params.lcsk_plus, &pipeline, 0, -1, nullptr, 0, &budget,
+          &task_stats[task], match_pairs);
+      for (const auto& run : recon) {
+        (*scores)[i] += run.length;
+      }
+      (*partial)[i] |= budget.expired();
+    }
+  });
+
+  for (const auto& some_stats : task_stats) {
+    AddDpStats(some_stats, stats);
+  }
+}
+
+// Statistics of the current call, stored into the stats given by the caller
+// if there are any. Every call has its own collector, so concurrent calls do
+// not share any state. It has to outlive the MatchPairs of the call.
+class StatsCollector {
+ public:
+  explicit StatsCollector(LcskppStats* stats)
+      : stats_(stats != nullptr ? stats : &local_stats_) {
+    *stats_ = LcskppStats();
+  }
+
+  ~StatsCollector() {
+    stats_->match_pairs_created = match_pairs_.objects_created;
+    stats_->max_live_match_pairs = match_pairs_.max_objects_alive;
+  }
+
+  LcskppStats* get() { return stats_; }
+  ObjectCounter* match_pairs() { return &match_pairs_; }
+
+ private:
+  LcskppStats local_stats_;
+  LcskppStats* stats_;
+  ObjectCounter match_pairs_;
+};
+
+// The streamed rows of LcskppSparseFastStream, the reconstruction against
+// reversed b is merged into the returned one.
+template <typename Position>
+vector<LcskppRun> LcskppSparseFastStreamImpl(
+    const LcskppReader &read_a, const LcskppReference &b,
+    const LcskppParams &params, CallBudget* budget, LcskppStats* stats,
+    ObjectCounter* match_pairs) {
+  const int k = params.k;
+  const vector<char> &char_to_id = b.char_to_id();
+  const int alphabet_size = b.alphabet_size();
+  // Same as the hash_mod of the RollingHasher which built the index.
+  unsigned long long hash_mod = 1;
+  for (int i = 0; i < k; ++i) {
+    hash_mod *= alphabet_size;
+  }
+
+  SparseDp<Position> dp(k, params.lcsk_plus, stats, match_pairs);
+  SparseDp<Position> reverse_dp(k, params.lcsk_plus, stats, match_pairs);
+  vector<char> buffer(kStreamBlockSize);
+  vector<unsigned long long> hashes;
+  unsigned long long hash = 0;
+  Position num_chars = 0;
+  Position next_row = 0;
+  while (size_t size = read_a(buffer.data(), buffer.size())) {
+    Stopwatch stopwatch;
+    hashes.clear();
+    for (size_t i = 0; i < size; ++i) {
+      hash = hash * alphabet_size + char_to_id[(unsigned char)buffer[i]];
+      hash %= hash_mod;
+      if (++num_chars >= k) {
+        hashes.push_back(hash);
+      }
+    }
+    stats->match_generation_seconds += stopwatch.Seconds();
+    ProcessStreamedRows(b.index(), hashes, next_row, &dp, budget, stats);
+    if (params.reverse) {
+      ProcessStreamedRows(b.reversed_index(), hashes, next_row, &reverse_dp,
+                          budget, stats);
+    }
+    next_row += hashes.size();
+    // The rest of a is not read.
+    if (budget->expired()) break;
+  }
+
+  // The last rows have no length k substrings, but matches still end there.
+  for (; next_row <= num_chars && !budget->Expired(); ++next_row) {
+    RecordRowMatches(0, stats);
+    dp.ProcessRow(next_row, nullptr, nullptr);
+    if (params.reverse) {
+      RecordRowMatches(0, stats);
+      reverse_dp.ProcessRow(next_row, nullptr, nullptr);
+    }
+  }
+
+  vector<LcskppRun> recon = dp.Reconstruction();
+  if (params.reverse) {
+    MergeReverseReconstruction(b.b().size(), reverse_dp.Reconstruction(),
+                               &recon, stats);
+  }
   return recon;
 }
 
@@ -306,22 +697,248 @@ vector<pair<int, int>> LcskppSparseFastImpl(const std::string &a,
 
 // exposed functions
 
+bool LcskppParamsValid(const std::string &a, const std::string &b,
+                       const LcskppParams &params) {
+  if (params.k <= 0 || params.aggressive_runs <= 0 ||
+      params.num_threads < 0 || params.min_score < 0 ||
+      params.time_budget_seconds < 0 || params.row_sampling <= 0 ||
+      (params.position_bits != 0 && params.position_bits != 32 &&
+       params.position_bits != 64) ||
+      b.size() > UINT32_MAX) {
+    return false;
+  }
+  const bool single = params.mode == LcskppParams::Mode::SINGLESTART;
+  const bool sparse = params.engine == LcskppParams::Engine::AUTO ||
+                      params.engine == LcskppParams::Engine::SPARSE;
+  const int64_t max_length = max(a.size(), b.size());
+  if ((params.position_bits == 32 && LongStrings(max_length, params.k)) ||
+      (LargePositions(max_length, params) && !sparse) ||
+      (params.row_sampling > 1 &&
+       (!single || !sparse || params.min_score > 0))) {
+    return false;
+  }
+  switch (params.engine) {
+    case LcskppParams::Engine::DENSE:
+      return single && FitsDense(a, b);
+    case LcskppParams::Engine::BANDED:
+      return single;
+    default:
+      return true;
+  }
+}
+
+LcskppResult LcskppSparseFastRuns(
+    const std::string &a, const std::string &b, const LcskppParams &params,
+    LcskppStats *stats) {
+  StatsCollector collector(stats);
+  LcskppResult result;
+  if (!LcskppParamsValid(a, b, params)) {
+    result.invalid_params = true;
+    return result;
+  }
+  CallBudget budget(params);
+  // Both instantiations take the same arguments.
+  const bool large = LargePositions(max(a.size(), b.size()), params);
+  auto impl = large ? LcskppSparseFastImpl<int64_t>
+                    : LcskppSparseFastImpl<int>;
+  const bool sampled = params.row_sampling > 1;
+  Stopwatch stopwatch;
+  LcskppPlan plan;
+  // Large and sampled calls only run on the sparse engine (LcskppParamsValid
+  // checked that they force no other one), the rest are planned.
+  if (!large && !sampled) {
+    plan = PlanLcskpp(a, b, params);
+    collector.get()->plan_seconds = stopwatch.Seconds();
+    collector.get()->estimated_matches = plan.estimated_matches;
+    collector.get()->predicted_seconds = plan.chosen().seconds;
+    collector.get()->predicted_bytes = plan.chosen().bytes;
+    collector.get()->band_offset = plan.band_offset;
+    collector.get()->band_width = plan.band_width;
+  }
+  collector.get()->engine = plan.engine;
+  collector.get()->position_bits = large ? 64 : 32;
+
+  int64_t upper_bound = 0;
+  result.runs = impl(
+      a, b, params.k, params.lcsk_plus, params.mode, params.aggressive_runs,
+      params.num_threads, plan.engine, plan.band_offset, plan.band_width,
+      params.min_score, params.row_sampling, params.hash_row_sampling,
+      &upper_bound, &budget, collector.get(), collector.match_pairs());
+  if (sampled) {
+    result.upper_bound = upper_bound;
+    result.estimated_size = EstimateSampledSize(result.runs, params,
+                                                upper_bound);
+  }
+  const bool reached =
+      params.min_score > 0 && result.size() >= (size_t)params.min_score;
+  if (params.reverse && !reached && !budget.Expired()) {
+    auto b_reversed = b;
+    std::reverse(b_reversed.begin(), b_reversed.end());
+    // The band on reversed b has nothing to do with the one on b.
+    int band_offset = params.band_offset;
+    int band_width = params.band_width;
+    if (plan.engine == LcskppParams::Engine::BANDED && band_width < 0) {
+      stopwatch.Restart();
+      EstimateBand(a, b_reversed, params.k, &band_offset, &band_width);
+      collector.get()->plan_seconds += stopwatch.Seconds();
+    }
+    auto recon_reverse = impl(
+        a, b_reversed, params.k, params.lcsk_plus, params.mode,
+        params.aggressive_runs, params.num_threads, plan.engine, band_offset,
+        band_width, params.min_score, params.row_sampling,
+        params.hash_row_sampling, &upper_bound, &budget, collector.get(),
+        collector.match_pairs());
+    if (sampled) {
+      result.upper_bound += upper_bound;
+      result.estimated_size += EstimateSampledSize(recon_reverse, params,
+                                                   upper_bound);
+    }
+    MergeReverseReconstruction(b.size(), recon_reverse, &result.runs,
+                               collector.get());
+  }
+  // Skipping the run on reversed b makes the result partial too.
+  result.partial = collector.get()->partial =
+      collector.get()->partial || (params.reverse && reached) ||
+      budget.expired();
+  return result;
+}
+
 vector<pair<int, int>> LcskppSparseFast(
-    const std::string &a, const std::string &b, const LcskppParams &params) {
-  auto recon = LcskppSparseFastImpl(
-      a, b, params.k, params.lcsk_plus, params.mode, params.aggressive_runs);
+    const std::string &a, const std::string &b, const LcskppParams &params,
+    LcskppStats *stats) {
+  return LcskppSparseFastRuns(a, b, params, stats).ToPairs();
+}
+
+vector<LcskppResult> LcskppSparseFastSweep(
+    const std::string &a, const std::string &b, const vector<int> &ks,
+    const LcskppParams &params, LcskppStats *stats) {
+  StatsCollector collector(stats);
+  collector.get()->engine = LcskppParams::Engine::SPARSE;
+  collector.get()->position_bits = 32;
+  vector<int> distinct_ks = ks;
+  sort(distinct_ks.begin(), distinct_ks.end());
+  distinct_ks.erase(unique(distinct_ks.begin(), distinct_ks.end()),
+                    distinct_ks.end());
+  vector<LcskppResult> results(ks.size());
+  if (distinct_ks.empty()) return results;
+  assert(distinct_ks[0] > 0);
+  assert(!LargePositions(max(a.size(), b.size()), params));
+
+  vector<CallBudget> budgets;
+  budgets.reserve(distinct_ks.size());
+  for (size_t i = 0; i < distinct_ks.size(); ++i) {
+    budgets.emplace_back(params);
+  }
+  auto recons = LcskppSweepImpl(a, b, distinct_ks, params.lcsk_plus,
+                                params.num_threads, &budgets, collector.get(),
+                                collector.match_pairs());
   if (params.reverse) {
     auto b_reversed = b;
     std::reverse(b_reversed.begin(), b_reversed.end());
-    auto recon_reverse = LcskppSparseFastImpl(
-        a, b_reversed, params.k, params.lcsk_plus, params.mode, params.aggressive_runs);
-    int b_len = b.size();
-    for (auto &match : recon_reverse) {
-      match.second = b_len - 1 - match.second;
+    auto recons_reverse = LcskppSweepImpl(
+        a, b_reversed, distinct_ks, params.lcsk_plus, params.num_threads,
+        &budgets, collector.get(), collector.match_pairs());
+    for (size_t i = 0; i < distinct_ks.size(); ++i) {
+      MergeReverseReconstruction(b.size(), recons_reverse[i], &recons[i],
+                                 collector.get());
     }
-    int middle = recon.size();
-    recon.insert(recon.end(), recon_reverse.begin(), recon_reverse.end());
-    inplace_merge(recon.begin(), recon.begin() + middle, recon.end());
   }
-  return recon;
+
+  for (size_t i = 0; i < ks.size(); ++i) {
+    const int j = lower_bound(distinct_ks.begin(), distinct_ks.end(), ks[i]) -
+                  distinct_ks.begin();
+    results[i].runs = recons[j];
+    results[i].partial = budgets[j].expired();
+    collector.get()->partial |= results[i].partial;
+  }
+  return results;
+}
+
+LcskppProfile LcskppSparseFastProfile(
+    const std::string &a, const std::string &b, int window, int stride,
+    const LcskppParams &params, LcskppStats *stats) {
+  assert(window > 0 && stride > 0 && params.k > 0);
+  assert(!LargePositions(max(a.size(), b.size()), params));
+  Stopwatch call_stopwatch;
+  StatsCollector collector(stats);
+  collector.get()->engine = LcskppParams::Engine::SPARSE;
+  collector.get()->position_bits = 32;
+  const int64_t length = max(a.size(), b.size());
+  const int num_windows =
+      length <= window ? 1 : (length - window + stride - 1) / stride + 1;
+  LcskppProfile profile;
+  profile.scores.assign(num_windows, 0);
+  vector<char> partial(num_windows, false);
+  LcskppProfileImpl(a, b, false, window, stride, params, call_stopwatch,
+                    &profile.scores, &partial, collector.get(),
+                    collector.match_pairs());
+  if (params.reverse) {
+    auto b_reversed = b;
+    std::reverse(b_reversed.begin(), b_reversed.end());
+    LcskppProfileImpl(a, b_reversed, true, window, stride, params,
+                      call_stopwatch, &profile.scores, &partial,
+                      collector.get(), collector.match_pairs());
+  }
+  profile.partial = collector.get()->partial =
+      find(partial.begin(), partial.end(), true) != partial.end();
+  return profile;
+}
+
+LcskppResult LcskppSparseFastStream(
+    const LcskppReader &read_a, const LcskppReference &b,
+    const LcskppParams &params, LcskppStats *stats_ptr) {
+  StatsCollector collector(stats_ptr);
+  LcskppResult result;
+  if (params.mode != LcskppParams::Mode::SINGLESTART || params.k != b.k()) {
+    result.invalid_params = true;
+    return result;
+  }
+  CallBudget budget(params);
+  LcskppStats* stats = collector.get();
+  stats->engine = LcskppParams::Engine::SPARSE;
+  // The length of a is not known, so unless forced or bounded by the caller
+  // the positions are 64-bit.
+  const bool bounded = params.position_bits != 0 || params.max_a_length > 0;
+  const bool large =
+      !bounded || LargePositions(max<int64_t>(params.max_a_length,
+                                              b.b().size()), params);
+  stats->position_bits = large ? 64 : 32;
+  auto impl = large ? LcskppSparseFastStreamImpl<int64_t>
+                    : LcskppSparseFastStreamImpl<int>;
+
+  // A bounded a is read up to the bound, checking that it ends there.
+  LcskppReader read = read_a;
+  int64_t num_read = 0;
+  bool too_long = false;
+  if (params.max_a_length > 0) {
+    read = [&](char *buffer, size_t size) -> size_t {
+      const int64_t left = params.max_a_length - num_read;
+      if (left == 0) {
+        char next;
+        too_long = read_a(&next, 1) > 0;
+        return 0;
+      }
+      size = read_a(buffer, min<int64_t>(size, left));
+      num_read += size;
+      return size;
+    };
+  }
+  result.runs = impl(read, b, params, &budget, stats, collector.match_pairs());
+  result.partial = stats->partial = budget.expired();
+  if (too_long) {
+    result.runs.clear();
+    result.invalid_params = true;
+  }
+  return result;
+}
+
+LcskppResult LcskppSparseFastStream(
+    std::istream &a, const LcskppReference &b, const LcskppParams &params,
+    LcskppStats *stats) {
+  return LcskppSparseFastStream(
+      [&a](char *buffer, size_t size) -> size_t {
+        a.read(buffer, size);
+        return a.gcount();
+      },
+      b, params, stats);
 }
@@ -15,10 +15,30 @@
 #ifndef LCSK
 #define LCSK
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "lcsk_result.h"
+
+class LcskppReference;
+
+// Lets a client abandon calls running in other threads, see
+// LcskppParams::cancel_token.
+class LcskppCancelToken {
+ public:
+  void Cancel() { cancelled_ = true; }
+  bool cancelled() const { return cancelled_; }
+
+ private:
+  std::atomic<bool> cancelled_{false};
+};
+
 struct LcskppParams {
   LcskppParams() = default;
   LcskppParams(int k) : k(k) {}
@@ -32,6 +52,22 @@ struct LcskppParams {
     MULTISTART_AGGRESSIVE,
   };
 
+  enum class Engine {
+    // Chosen by the planner (see planner.h) from the lengths of the strings
+    // and their estimated number of matches.
+    AUTO,
+    // Sparse dynamic programming over the matches of length k substrings.
+    SPARSE,
+    // Bit-parallel dynamic programming over all of the cells, see
+    // dense_dp.h. Only for SINGLESTART mode and inputs for which FitsDense
+    // holds.
+    DENSE,
+    // Sparse dynamic programming over the matches in a band of diagonals
+    // (see band_width), for strings whose LCSk stays close to a diagonal.
+    // Only for SINGLESTART mode.
+    BANDED,
+  };
+
   // If true lcsk++ is used, otherwise standard lcsk algorithm.
   bool lcsk_plus = true;
   // If true matching is also calculated on reversed string.
@@ -41,10 +77,198 @@ struct LcskppParams {
   int k = 3;
   // Number of runs in MULTISTART_AGGRESSIVE mode, in other modes ignored.
   int aggressive_runs = 3;
+  // Maximal number of threads used, 0 means one per hardware core. Besides
+  // generating the matches, SINGLESTART runs of the sparse engine on a long
+  // b split the dp between them (see wavefront_dp.h).
+  int num_threads = 1;
+  // Engine computing the dp, anything but AUTO forces it. Calls forcing an
+  // engine which is not able to run them (see above) are invalid, see
+  // LcskppParamsValid.
+  Engine engine = Engine::AUTO;
+  // Band of the BANDED engine: only the matches (row, col) with
+  // |row - col - band_offset| <= band_width are used, where the row is the
+  // position in a and the col the one in b (reversed b for the run on it).
+  // Matches out of the band are not generated at all. If band_width is
+  // negative the band of every run is estimated from sampled unique
+  // matches. Setting it promises that the LCSk stays in the band, which
+  // lets AUTO choose the BANDED engine.
+  int band_width = -1;
+  int band_offset = 0;
+  // Budget of a call. Once time_budget_seconds passed since the call
+  // started, the dp would process more than match_budget matches or the
+  // cancel token is cancelled, the call stops and returns the best chain
+  // found in the rows processed so far, marked as partial. Zeros (and null)
+  // mean no limit. The budget is checked once per row of the dp and between
+  // the runs, the ones on reversed b included.
+  double time_budget_seconds = 0;
+  uint64_t match_budget = 0;
+  const LcskppCancelToken* cancel_token = nullptr;
+  // For callers which only need to know whether the LCSk reaches a score.
+  // If positive, a run stops as soon as its best chain is min_score
+  // characters long, or once an upper bound of what it can still reach
+  // falls below min_score. The result is marked as partial then, the chain
+  // is the best one found until then. With reverse the run on reversed b
+  // is skipped if the one on b reached min_score. Only SINGLESTART runs of
+  // the SPARSE and BANDED engines stop early, streamed calls do not.
+  int min_score = 0;
+  // Width of the positions in a and b the dp works with, 32 or 64 bits.
+  // 32-bit positions keep the MatchPairs and the compressed table small,
+  // 64-bit ones are needed for strings of about 2^31 characters or longer.
+  // The default 0 picks them from the lengths of the strings. Streamed calls
+  // do not know the length of a, they pick them from max_a_length instead
+  // and use 64-bit ones if it is not set. Calls with 64-bit positions only
+  // run on the sparse engine and are not planned, sweeps only support
+  // 32-bit ones. Forcing 32-bit positions on strings too long for them is
+  // invalid. Either way b has to be shorter than 2^32 characters, the index
+  // stores its positions in 32 bits.
+  int position_bits = 0;
+  // Bound on the length of a streamed a, 0 if there is none. Lets streamed
+  // calls use 32-bit positions when the bound and the length of b are short
+  // enough. If a turns out longer, the call reads only a character past the
+  // bound and returns an empty result marked with invalid_params.
+  int64_t max_a_length = 0;
+  // Approximation for screening. If row_sampling is s > 1, only the matches
+  // beginning in every s-th row of a are generated and chained, or with
+  // hash_row_sampling the ones of about one in s rows, chosen by the hash of
+  // their length k substring. The chain found is a valid one, so its length
+  // is a lower bound of the LCSk++ length, LcskppResult::estimated_size
+  // estimates it and upper_bound bounds it from above. Strided samples are
+  // most accurate for s dividing k, bench_sampling measures the errors.
+  // Only SINGLESTART calls on the sparse engine without a min_score sample,
+  // other calls sampling rows are invalid.
+  int row_sampling = 1;
+  bool hash_row_sampling = false;
+};
+
+// Statistics of a single call. Runs on reversed b and multistart runs are
+// added together.
+struct LcskppStats {
+  // Engine the call ran on, the estimated number of matches of a against b
+  // and the time and memory the planner predicted for the engine. Streamed
+  // calls and calls with 64-bit positions always run on the sparse engine
+  // and are not planned.
+  LcskppParams::Engine engine = LcskppParams::Engine::AUTO;
+  uint64_t estimated_matches = 0;
+  double predicted_seconds = 0;
+  uint64_t predicted_bytes = 0;
+  // Band of the run on b (not reversed) of the BANDED engine.
+  int band_offset = 0;
+  int band_width = -1;
+  // True if the call ran out of its budget or stopped at min_score, see
+  // LcskppParams.
+  bool partial = false;
+  // Width of the positions the call ran with, see
+  // LcskppParams::position_bits.
+  int position_bits = 0;
+
+  // Wall time of the phases, in seconds. Matches may be generated by several
+  // threads while the dp runs, their time is summed over the threads.
+  double plan_seconds = 0;
+  double alphabet_seconds = 0;
+  double index_seconds = 0;
+  double match_generation_seconds = 0;
+  double dp_seconds = 0;
+  double reconstruction_seconds = 0;
+  // Combining the reconstructions of the reverse and multistart runs.
+  double merge_seconds = 0;
+
+  uint64_t num_matches = 0;
+  // row_match_histogram[0] is the number of rows without matches and
+  // row_match_histogram[i] the number of rows with [2^(i-1), 2^i) of them.
+  std::vector<uint64_t> row_match_histogram;
+  // Largest size the compressed table reached.
+  uint64_t compressed_table_size = 0;
+  // Rows for which the dp values were queried in a single pass over the
+  // compressed table, and by a binary search per match.
+  uint64_t amortized_rows = 0;
+  uint64_t elementwise_rows = 0;
+  // Number of MatchPairs created and the largest number of them alive at the
+  // same time. Both are 0 when built with LCSK_NO_COUNTERS.
+  uint64_t match_pairs_created = 0;
+  uint64_t max_live_match_pairs = 0;
 };
 
-// Find LCSk of strings a and b.
+// All of the functions below are reentrant: they can be called from several
+// threads at the same time, sharing the same LcskppReference too.
+
+// True if LcskppSparseFast and LcskppSparseFastRuns are able to run a call
+// with params on a and b: the fields are in range and the forced engine
+// supports the mode, the strings, their positions and row sampling (see
+// LcskppParams). Other calls compute nothing, their result is marked with
+// invalid_params.
+bool LcskppParamsValid(const std::string &a, const std::string &b,
+                       const LcskppParams &params);
+
+// Find LCSk of strings a and b. If stats is not null, the statistics of the
+// call are stored there. The pairs are ints, so the strings have to be
+// shorter than 2^31 characters, LcskppSparseFastRuns takes longer ones.
 std::vector<std::pair<int, int>> LcskppSparseFast(
-    const std::string &a, const std::string &b, const LcskppParams &params);
+    const std::string &a, const std::string &b, const LcskppParams &params,
+    LcskppStats *stats = nullptr);
+
+// Same as LcskppSparseFast, but the reconstruction is returned as runs of
+// consecutive matches, which is much smaller for similar strings. Iterating
+// over the result gives the pairs LcskppSparseFast returns.
+LcskppResult LcskppSparseFastRuns(
+    const std::string &a, const std::string &b, const LcskppParams &params,
+    LcskppStats *stats = nullptr);
+
+// LCSk++ of a and b for every k of ks, results[i] is the one for ks[i] and
+// its size() the score. Much cheaper than a call per k: b is indexed and
+// the matches are generated once, for the smallest k, and joined into
+// maximal diagonal runs (see match_maker.h). The matches of every k are read
+// from the runs at least k long, and the dps of the ks run in parallel on
+// params.num_threads threads. The sparse engine is used in SINGLESTART mode,
+// params.k, mode, engine, band and min_score are ignored. Every k has a
+// budget of its own, its time counted from the start of the call. The stats
+// are summed over the ks.
+std::vector<LcskppResult> LcskppSparseFastSweep(
+    const std::string &a, const std::string &b, const std::vector<int> &ks,
+    const LcskppParams &params, LcskppStats *stats = nullptr);
+
+// Score track of LcskppSparseFastProfile.
+struct LcskppProfile {
+  // scores[i] is the LCSk++ length of the windows beginning at i * stride.
+  std::vector<int> scores;
+  // True if the budget expired before some of the windows were done, their
+  // scores are the best chains found until then.
+  bool partial = false;
+};
+
+// LCSk++ along a and b: the length of the LCSk++ of a.substr(s, window) and
+// b.substr(s, window) for s = 0, stride, 2 * stride, ... until the windows
+// reach the end of the longer string. Gives the scores of a call per pair of
+// windows, but b is indexed and the matches generated once and joined into
+// maximal diagonal runs (see match_maker.h). The window slides over the
+// runs, clipping them to its bounds. Windows are computed in parallel on
+// params.num_threads threads by the sparse engine in SINGLESTART mode,
+// params.mode, engine, band and min_score are ignored. With reverse the
+// score of a window includes its run on the reversed window of b, as the
+// size of LcskppSparseFastRuns does. Every window has a match budget of its
+// own, the time budget and the cancel token are the ones of the call. The
+// stats are summed over the windows. Strings have to be shorter than 2^31
+// characters.
+LcskppProfile LcskppSparseFastProfile(
+    const std::string &a, const std::string &b, int window, int stride,
+    const LcskppParams &params, LcskppStats *stats = nullptr);
+
+// Reads the next at most size characters of a into buffer and returns their
+// number, 0 at the end of a.
+typedef std::function<size_t(char *buffer, size_t size)> LcskppReader;
+
+// Find LCSk of a streamed string a and an indexed string b (see
+// reference.h). a is consumed in blocks, so apart from the result the memory
+// used does not depend on its length. Only SINGLESTART mode is supported and
+// params.k has to be the k b was indexed for, otherwise nothing is computed
+// and the result is marked with invalid_params. Gives the same result as
+// LcskppSparseFastRuns. The positions are 64-bit unless params.position_bits
+// or params.max_a_length says otherwise.
+// Alphabet and index times are not part of the stats, b was indexed before.
+LcskppResult LcskppSparseFastStream(
+    const LcskppReader &read_a, const LcskppReference &b,
+    const LcskppParams &params, LcskppStats *stats = nullptr);
+LcskppResult LcskppSparseFastStream(
+    std::istream &a, const LcskppReference &b, const LcskppParams &params,
+    LcskppStats *stats = nullptr);
 
 #endif
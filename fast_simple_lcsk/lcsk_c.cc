@@ -0,0 +1,171 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lcsk_c.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lcsk.h"
+#include "../util/parallel.h"
+
+using namespace std;
+
+namespace {
+
+// The enums have to be in range to be converted, the rest is checked by
+// LcskppParamsValid.
+bool ToParams(const lcsk_params& c_params, const string& a, const string& b,
+              LcskppParams* params) {
+  if (c_params.mode < LCSK_MODE_SINGLESTART ||
+      c_params.mode > LCSK_MODE_MULTISTART_AGGRESSIVE ||
+      c_params.engine < LCSK_ENGINE_AUTO ||
+      c_params.engine > LCSK_ENGINE_BANDED) {
+    return false;
+  }
+  params->k = c_params.k;
+  params->lcsk_plus = c_params.lcsk_plus != 0;
+  params->reverse = c_params.reverse != 0;
+  params->mode = static_cast<LcskppParams::Mode>(c_params.mode);
+  params->aggressive_runs = c_params.aggressive_runs;
+  params->num_threads = c_params.num_threads;
+  params->engine = static_cast<LcskppParams::Engine>(c_params.engine);
+  params->band_width = c_params.band_width;
+  params->band_offset = c_params.band_offset;
+  params->min_score = c_params.min_score;
+  params->position_bits = c_params.position_bits;
+  params->row_sampling = c_params.row_sampling;
+  params->hash_row_sampling = c_params.hash_row_sampling != 0;
+  params->time_budget_seconds = c_params.time_budget_seconds;
+  params->match_budget = c_params.match_budget;
+  return LcskppParamsValid(a, b, *params);
+}
+
+// Computes the pair into *result, its runs are kept in *runs.
+void Compute(const char* a_data, size_t a_length, const char* b_data,
+             size_t b_length, const lcsk_params& c_params, int num_threads,
+             LcskppResult* runs, lcsk_result* result) {
+  *result = lcsk_result();
+  try {
+    const string a(a_data, a_length);
+    const string b(b_data, b_length);
+    LcskppParams params;
+    if (!ToParams(c_params, a, b, &params)) {
+      result->status = LCSK_ERROR_INVALID_ARGUMENT;
+      return;
+    }
+    params.num_threads = num_threads;
+    *runs = LcskppSparseFastRuns(a, b, params);
+  } catch (...) {
+    result->status = LCSK_ERROR_INTERNAL;
+    return;
+  }
+  result->status = LCSK_OK;
+  result->partial = runs->partial;
+  result->size = runs->size();
+  result->num_runs = runs->runs.size();
+  result->estimated_size = runs->estimated_size;
+  result->upper_bound = runs->upper_bound;
+}
+
+void CopyRuns(const LcskppResult& result, lcsk_run* runs) {
+  for (const LcskppRun& run : result.runs) {
+    *runs++ = {run.a_start, run.b_start, run.length, run.reverse, 0};
+  }
+}
+
+}  // namespace
+
+int lcsk_abi_version(void) { return LCSK_ABI_VERSION; }
+
+void lcsk_default_params(lcsk_params* params) {
+  const LcskppParams defaults;
+  *params = lcsk_params();
+  params->k = defaults.k;
+  params->lcsk_plus = defaults.lcsk_plus;
+  params->reverse = defaults.reverse;
+  params->mode = static_cast<int32_t>(defaults.mode);
+  params->aggressive_runs = defaults.aggressive_runs;
+  params->num_threads = defaults.num_threads;
+  params->engine = static_cast<int32_t>(defaults.engine);
+  params->band_width = defaults.band_width;
+  params->band_offset = defaults.band_offset;
+  params->min_score = defaults.min_score;
+  params->position_bits = defaults.position_bits;
+  params->row_sampling = defaults.row_sampling;
+  params->hash_row_sampling = defaults.hash_row_sampling;
+  params->time_budget_seconds = defaults.time_budget_seconds;
+  params->match_budget = defaults.match_budget;
+}
+
+int lcsk_compute(const char* a, size_t a_length, const char* b,
+                 size_t b_length, const lcsk_params* params, lcsk_run* runs,
+                 size_t runs_capacity, lcsk_result* result) {
+  LcskppResult computed;
+  Compute(a, a_length, b, b_length, *params, params->num_threads, &computed,
+          result);
+  if (result->status != LCSK_OK) return result->status;
+  if (result->num_runs > runs_capacity) {
+    result->status = LCSK_ERROR_CAPACITY;
+    return result->status;
+  }
+  CopyRuns(computed, runs);
+  return LCSK_OK;
+}
+
+int lcsk_compute_batch(const lcsk_pair* pairs, size_t num_pairs,
+                       const lcsk_params* params, lcsk_run* runs,
+                       size_t runs_capacity, lcsk_result* results) {
+  // The pairs are indexed by int.
+  if (num_pairs > (size_t)INT_MAX || params->num_threads < 0) {
+    return LCSK_ERROR_INVALID_ARGUMENT;
+  }
+  // The threads are spent on the pairs, every one of them is computed on a
+  // single thread. Runs are kept until the offsets are known.
+  vector<LcskppResult> computed;
+  try {
+    computed.resize(num_pairs);
+    ParallelFor(num_pairs, ResolveNumThreads(params->num_threads),
+                [&](int i) {
+                  Compute(pairs[i].a, pairs[i].a_length, pairs[i].b,
+                          pairs[i].b_length, *params, 1, &computed[i],
+                          &results[i]);
+                });
+  } catch (...) {
+    return LCSK_ERROR_INTERNAL;
+  }
+
+  int status = LCSK_OK;
+  uint64_t offset = 0;
+  bool full = false;
+  for (size_t i = 0; i < num_pairs; ++i) {
+    results[i].runs_offset = offset;
+    if (results[i].status == LCSK_OK) {
+      full = full || offset + results[i].num_runs > runs_capacity;
+      if (full) {
+        results[i].status = LCSK_ERROR_CAPACITY;
+      } else {
+        CopyRuns(computed[i], runs + offset);
+        offset += results[i].num_runs;
+      }
+    }
+    if (status == LCSK_OK) status = results[i].status;
+    // Memory of the pairs copied is released as the copying goes on.
+    vector<LcskppRun>().swap(computed[i].runs);
+  }
+  return status;
+}
@@ -0,0 +1,148 @@
+/* Copyright 2018 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* C interface of liblcsk.so, for calling LcskppSparseFastRuns from other
+ * languages. Strings and results live in memory owned by the caller, the
+ * library does not allocate anything the caller has to free and keeps no
+ * state between the calls, which can be made from several threads at the
+ * same time.
+ *
+ * The layout of the structs only changes together with LCSK_ABI_VERSION.
+ */
+
+#ifndef LCSK_C
+#define LCSK_C
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define LCSK_EXPORT __attribute__((visibility("default")))
+#else
+#define LCSK_EXPORT
+#endif
+
+#define LCSK_ABI_VERSION 1
+
+/* Status codes returned by the functions. */
+#define LCSK_OK 0
+/* A parameter is out of its range, or a combination of them is not
+ * supported (see LcskppParamsValid in lcsk.h). */
+#define LCSK_ERROR_INVALID_ARGUMENT 1
+/* The runs do not fit into the memory given for them. */
+#define LCSK_ERROR_CAPACITY 2
+/* The computation failed, e.g. it ran out of memory. */
+#define LCSK_ERROR_INTERNAL 3
+
+/* Values of lcsk_params.mode and engine, as in LcskppParams. */
+#define LCSK_MODE_SINGLESTART 0
+#define LCSK_MODE_MULTISTART_2D_LOGARITHMIC 1
+#define LCSK_MODE_MULTISTART_AGGRESSIVE 2
+#define LCSK_ENGINE_AUTO 0
+#define LCSK_ENGINE_SPARSE 1
+#define LCSK_ENGINE_DENSE 2
+#define LCSK_ENGINE_BANDED 3
+
+/* Fields of LcskppParams, see lcsk.h. Booleans are 0 or 1. The cancel token
+ * is not available. */
+typedef struct {
+  int32_t k;
+  int32_t lcsk_plus;
+  int32_t reverse;
+  int32_t mode;
+  int32_t aggressive_runs;
+  int32_t num_threads;
+  int32_t engine;
+  int32_t band_width;
+  int32_t band_offset;
+  int32_t min_score;
+  int32_t position_bits;
+  int32_t row_sampling;
+  int32_t hash_row_sampling;
+  int32_t reserved;
+  double time_budget_seconds;
+  uint64_t match_budget;
+} lcsk_params;
+
+/* A run of matched characters, see LcskppRun. */
+typedef struct {
+  int64_t a_start;
+  int64_t b_start;
+  int64_t length;
+  int32_t reverse;
+  int32_t reserved;
+} lcsk_run;
+
+/* Result of a pair, its runs are stored separately. */
+typedef struct {
+  int32_t status;
+  int32_t partial;
+  /* Number of matched pairs, the LCSk++ length. */
+  int64_t size;
+  /* Number of runs, also when they did not fit. */
+  uint64_t num_runs;
+  /* Index of the first run of the pair in the runs of a batch. */
+  uint64_t runs_offset;
+  /* See LcskppResult, only set when sampling rows. */
+  double estimated_size;
+  int64_t upper_bound;
+} lcsk_result;
+
+/* A pair of a batch, the strings are not null terminated. */
+typedef struct {
+  const char* a;
+  size_t a_length;
+  const char* b;
+  size_t b_length;
+} lcsk_pair;
+
+/* LCSK_ABI_VERSION the library was built with. */
+LCSK_EXPORT int lcsk_abi_version(void);
+
+/* Fills params with the defaults of LcskppParams. */
+LCSK_EXPORT void lcsk_default_params(lcsk_params* params);
+
+/* LcskppSparseFastRuns of a and b. Up to runs_capacity runs are written to
+ * runs and the rest of the result to *result. Returns its status, if it is
+ * LCSK_ERROR_CAPACITY result->num_runs tells how many runs there are. */
+LCSK_EXPORT int lcsk_compute(const char* a, size_t a_length, const char* b,
+                             size_t b_length, const lcsk_params* params,
+                             lcsk_run* runs, size_t runs_capacity,
+                             lcsk_result* result);
+
+/* lcsk_compute of num_pairs pairs in a single call. The pairs are computed
+ * on params->num_threads threads (0 means one per core), every pair on one
+ * of them. The runs of the pairs are packed into runs in the order of the
+ * pairs, those of pairs[i] beginning at results[i].runs_offset. If the runs
+ * of a pair do not fit, its status and the ones of the pairs after it are
+ * LCSK_ERROR_CAPACITY. Returns LCSK_OK if all of the pairs succeeded and the
+ * first status which is not LCSK_OK otherwise. More than INT_MAX pairs or a
+ * negative params->num_threads give LCSK_ERROR_INVALID_ARGUMENT and a batch
+ * which failed as a whole (e.g. its threads could not be started)
+ * LCSK_ERROR_INTERNAL, the results are not meaningful then. */
+LCSK_EXPORT int lcsk_compute_batch(const lcsk_pair* pairs, size_t num_pairs,
+                                   const lcsk_params* params, lcsk_run* runs,
+                                   size_t runs_capacity,
+                                   lcsk_result* results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LCSK_C */
@@ -0,0 +1,125 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lcsk_result.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <tuple>
+
+using namespace std;
+
+namespace {
+
+// Diagonal of the run, together with its direction it determines which
+// pairs the runs can share.
+int64_t Diagonal(const LcskppRun& run) {
+  return run.reverse ? run.b_start + run.a_start : run.b_start - run.a_start;
+}
+
+}  // namespace
+
+LcskppResult::const_iterator::const_iterator(const vector<LcskppRun>* runs,
+                                             size_t index)
+    : runs_(runs), next_run_(0), index_(index) {
+  if (index_ == 0) {
+    StartNextRun();
+  }
+}
+
+void LcskppResult::const_iterator::StartNextRun() {
+  if (next_run_ == (int)runs_->size()) return;
+  const LcskppRun& run = (*runs_)[next_run_];
+  heap_.push_back(Cursor{make_pair(run.a_start, run.b_start), next_run_, 0});
+  push_heap(heap_.begin(), heap_.end(), [](const Cursor& x, const Cursor& y) {
+    return x.pair > y.pair;
+  });
+  ++next_run_;
+}
+
+LcskppResult::const_iterator& LcskppResult::const_iterator::operator++() {
+  auto greater = [](const Cursor& x, const Cursor& y) {
+    return x.pair > y.pair;
+  };
+  pop_heap(heap_.begin(), heap_.end(), greater);
+  Cursor cursor = heap_.back();
+  heap_.pop_back();
+  if (cursor.offset == 0 && cursor.run == next_run_ - 1) {
+    // Runs are sorted by their first pair, so the next one can not begin
+    // before this one did.
+    StartNextRun();
+  }
+
+  const LcskppRun& run = (*runs_)[cursor.run];
+  if (++cursor.offset < run.length) {
+    cursor.pair =
+        make_pair(run.a_start + cursor.offset, run.b_at(cursor.offset));
+    heap_.push_back(cursor);
+    push_heap(heap_.begin(), heap_.end(), greater);
+  }
+  ++index_;
+  return *this;
+}
+
+size_t LcskppResult::size() const {
+  size_t size = 0;
+  for (const auto& run : runs) {
+    size += run.length;
+  }
+  return size;
+}
+
+vector<pair<int, int>> LcskppResult::ToPairs() const {
+  // The pairs hold int positions.
+  for (const auto& run : runs) {
+    assert(run.a_start + run.length <= INT_MAX &&
+           max(run.b_at(0), run.b_at(run.length - 1)) < INT_MAX);
+  }
+  vector<pair<int, int>> pairs;
+  pairs.reserve(size());
+  pairs.assign(begin(), end());
+  return pairs;
+}
+
+void NormalizeRuns(vector<LcskppRun>* runs_ptr) {
+  auto& runs = *runs_ptr;
+  sort(runs.begin(), runs.end(),
+       [](const LcskppRun& x, const LcskppRun& y) {
+         return make_tuple(x.reverse, Diagonal(x), x.a_start) <
+                make_tuple(y.reverse, Diagonal(y), y.a_start);
+       });
+
+  int merged = 0;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    if (merged > 0) {
+      LcskppRun& last = runs[merged - 1];
+      if (last.reverse == runs[i].reverse &&
+          Diagonal(last) == Diagonal(runs[i]) &&
+          runs[i].a_start <= last.a_start + last.length) {
+        last.length = max(last.length,
+                          runs[i].a_start + runs[i].length - last.a_start);
+        continue;
+      }
+    }
+    runs[merged++] = runs[i];
+  }
+  runs.resize(merged);
+
+  sort(runs.begin(), runs.end(),
+       [](const LcskppRun& x, const LcskppRun& y) {
+         return make_tuple(x.a_start, x.b_start, x.reverse, x.length) <
+                make_tuple(y.a_start, y.b_start, y.reverse, y.length);
+       });
+}
@@ -0,0 +1,126 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LCSK_RESULT
+#define LCSK_RESULT
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+// A run of matched characters along a diagonal: a[a_start + i] is matched
+// with b[b_start + i], or with b[b_start - i] for the runs found against
+// reversed b, for 0 <= i < length.
+struct LcskppRun {
+  int64_t a_start;
+  int64_t b_start;
+  int64_t length;
+  bool reverse;
+
+  // Position in b matched with a[a_start + i].
+  int64_t b_at(int64_t i) const { return reverse ? b_start - i : b_start + i; }
+
+  bool operator==(const LcskppRun& other) const {
+    return a_start == other.a_start && b_start == other.b_start &&
+           length == other.length && reverse == other.reverse;
+  }
+};
+
+// Reconstruction of LCSk stored as runs, sorted by their first pair and
+// with no two runs in the same direction overlapping.
+struct LcskppResult {
+  std::vector<LcskppRun> runs;
+  // True if the call computing it ran out of its budget or stopped at
+  // min_score (see LcskppParams), runs then hold the best chain found in the
+  // rows processed until then.
+  bool partial = false;
+  // Only set by calls sampling the rows of a (see LcskppParams::
+  // row_sampling), for which size() is a lower bound of the LCSk++ length:
+  // its estimate and an upper bound of it.
+  double estimated_size = 0;
+  int64_t upper_bound = 0;
+  // True if the call did not run because its params are not supported by
+  // the function called or a streamed a was longer than
+  // LcskppParams::max_a_length (see lcsk.h), runs are empty then.
+  bool invalid_params = false;
+
+  // Iterates over the matched pairs of positions (in a, in b) in increasing
+  // order, expanding the runs on the fly.
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<int64_t, int64_t> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const value_type* pointer;
+    typedef const value_type& reference;
+
+    const_iterator() : runs_(nullptr), next_run_(0), index_(0) {}
+
+    reference operator*() const { return heap_.front().pair; }
+    pointer operator->() const { return &heap_.front().pair; }
+    const_iterator& operator++();
+    const_iterator operator++(int) {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const const_iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return index_ != other.index_;
+    }
+
+   private:
+    friend struct LcskppResult;
+
+    struct Cursor {
+      value_type pair;
+      int run;
+      int64_t offset;
+    };
+
+    const_iterator(const std::vector<LcskppRun>* runs, size_t index);
+    // Adds the first pair of the next run to the heap.
+    void StartNextRun();
+
+    const std::vector<LcskppRun>* runs_;
+    // Cursors of the runs which are being expanded, as a min heap. Besides
+    // the runs which were started, it holds the first pair of the next one.
+    std::vector<Cursor> heap_;
+    int next_run_;
+    size_t index_;
+  };
+
+  // end() calls size(), so both take time linear in the number of runs.
+  const_iterator begin() const { return const_iterator(&runs, 0); }
+  const_iterator end() const { return const_iterator(&runs, size()); }
+
+  // Number of matched pairs, summed over the runs.
+  size_t size() const;
+
+  // Expands the runs into pairs, as returned by LcskppSparseFast. Only for
+  // strings shorter than 2^31 characters (asserted), iterate over the longer
+  // ones.
+  std::vector<std::pair<int, int>> ToPairs() const;
+};
+
+// Brings runs into the form described at LcskppResult: runs in the same
+// direction on the same diagonal which overlap or touch are merged and the
+// runs are sorted.
+void NormalizeRuns(std::vector<LcskppRun>* runs);
+
+#endif  // LCSK_RESULT
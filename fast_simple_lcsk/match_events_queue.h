@@ -15,23 +15,41 @@
 #ifndef MATCH_EVENTS_QUEUE
 #define MATCH_EVENTS_QUEUE
 
+#include <limits>
 #include <queue>
 #include <tuple>
 #include <utility>
 #include "match_pair.h"
 
+// Events of the matches beginning (row, col, nullptr) or ending
+// (row, col, pair) in the rows of the dp, in row order.
+template <typename Position>
 struct MatchEventsQueue {
-  std::queue<std::tuple<int, int, std::shared_ptr<MatchPair>>> begin;
-  std::queue<std::tuple<int, int, std::shared_ptr<MatchPair>>> end;
+  typedef std::tuple<Position, Position,
+                     std::shared_ptr<MatchPair<Position>>> Event;
 
-  void AddBegin(const std::tuple<int, int, std::shared_ptr<MatchPair>>& event) {
+  std::queue<Event> begin;
+  std::queue<Event> end;
+  // Used by the stripes of the wavefront dp (see SparseDp::set_stripe).
+  // End events in passed_col or right of it go to passed instead of end, to
+  // be handed to the stripe on the right. The ones handed to this stripe
+  // go to received, they come before the ones in end of the same row.
+  Position passed_col = std::numeric_limits<Position>::max();
+  std::queue<Event> passed;
+  std::queue<Event> received;
+
+  void AddBegin(const Event& event) {
     begin.push(event);
   }
-  void AddEnd(const std::tuple<int, int, std::shared_ptr<MatchPair>>& event) {
-    end.push(event);
+  void AddEnd(const Event& event) {
+    if (std::get<1>(event) >= passed_col) {
+      passed.push(event);
+    } else {
+      end.push(event);
+    }
   }
 
-  bool PopBegin(int row, std::tuple<int, int, std::shared_ptr<MatchPair>>* event) {
+  bool PopBegin(Position row, Event* event) {
     if (!begin.empty() && std::get<0>(begin.front()) == row) {
       *event = begin.front();
       begin.pop();
@@ -40,7 +58,12 @@ struct MatchEventsQueue {
     return false;
   }
 
-  bool PopEnd(int row, std::tuple<int, int, std::shared_ptr<MatchPair>>* event) {
+  bool PopEnd(Position row, Event* event) {
+    if (!received.empty() && std::get<0>(received.front()) == row) {
+      *event = received.front();
+      received.pop();
+      return true;
+    }
     if (!end.empty() && std::get<0>(end.front()) == row) {
       *event = end.front();
       end.pop();
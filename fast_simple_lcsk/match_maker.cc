@@ -14,17 +14,32 @@
 
 #include "match_maker.h"
 
+#include <algorithm>
+
+#include "../util/parallel.h"
+
 using namespace std;
 
+namespace {
+
+// Number of rows of a whose runs are found by a single task, and the rows
+// of a bucket of RunsMatchMaker.
+const int kRunsRowsPerBlock = 4096;
+
+}  // namespace
+
 // static
 std::unique_ptr<MatchMaker> MatchMaker::Create(const string& a, const string& b,
-                                               int k, MatchMakerType type) {
+                                               int k, MatchMakerType type,
+                                               int num_threads) {
   std::unique_ptr<MatchMaker> match_maker;
   switch (type) {
     case MatchMakerType::NAIVE:
       match_maker.reset(new NaiveMatchMaker(a, b, k));
+      break;
     case MatchMakerType::PERFECT_HASH:
-      match_maker.reset(new PerfectHashMatchMaker(a, b, k));
+      match_maker.reset(new PerfectHashMatchMaker(a, b, k, num_threads));
+      break;
   }
   return match_maker;
 }
@@ -44,6 +59,25 @@ bool NaiveMatchMaker::GetNextMatches(std::vector<int>* matches) {
   return true;
 }
 
+void NaiveMatchMaker::GetMatchesBlock(int64_t row_begin, int64_t row_end,
+                                      MatchesBlock* block) const {
+  block->row_begin = row_begin;
+  block->row_end = row_end;
+  block->offsets.assign(1, 0);
+  block->cols.clear();
+  for (int64_t row = row_begin; row < row_end; ++row) {
+    if (row + k_ <= (int64_t)a_.size()) {
+      for (int64_t b_index = 0; b_index <= (int64_t)b_.size() - k_;
+           ++b_index) {
+        if (a_.compare(row, k_, b_, b_index, k_) == 0) {
+          block->cols.push_back(b_index);
+        }
+      }
+    }
+    block->offsets.push_back(block->cols.size());
+  }
+}
+
 bool PerfectHashMatchMaker::GetNextMatches(std::vector<int>* matches) {
   matches->clear();
   unsigned long long hash = 0;
@@ -55,14 +89,89 @@ bool PerfectHashMatchMaker::GetNextMatches(std::vector<int>* matches) {
   }
 
   assert(ahasher_->Next(&hash));
-  for (int x : bmap_[hash]) {
-    matches->push_back(x);
+  const uint32_t* begin;
+  const uint32_t* end;
+  if (SampledRow(row_, hash) && bmap_.Find(hash, &begin, &end)) {
+    ClipToBand(row_, &begin, &end);
+    matches->assign(begin, end);
   }
 
   ++row_;  // Not forgetting to update this!
   return true;
 }
 
+void PerfectHashMatchMaker::GetMatchesBlock(int64_t row_begin,
+                                            int64_t row_end,
+                                            MatchesBlock* block) const {
+  block->row_begin = row_begin;
+  block->row_end = row_end;
+  block->offsets.assign(1, 0);
+  block->cols.clear();
+
+  vector<const uint32_t*> begins;
+  vector<const uint32_t*> ends;
+  FindRows(row_begin, row_end, &begins, &ends);
+  for (int64_t row = row_begin; row < row_end; ++row) {
+    const int i = row - row_begin;
+    if (i < (int)begins.size()) {
+      block->cols.insert(block->cols.end(), begins[i], ends[i]);
+    }
+    block->offsets.push_back(block->cols.size());
+  }
+}
+
+void PerfectHashMatchMaker::CountMatches(int64_t row_begin, int64_t row_end,
+                                         int* counts) const {
+  vector<const uint32_t*> begins;
+  vector<const uint32_t*> ends;
+  FindRows(row_begin, row_end, &begins, &ends);
+  for (int64_t row = row_begin; row < row_end; ++row) {
+    const int i = row - row_begin;
+    counts[i] = i < (int)begins.size() ? ends[i] - begins[i] : 0;
+  }
+}
+
+void PerfectHashMatchMaker::FindRows(int64_t row_begin, int64_t row_end,
+                                     vector<const uint32_t*>* begins,
+                                     vector<const uint32_t*>* ends) const {
+  // The hashes of the whole block are computed up front, so the index can
+  // resolve them as a single batch.
+  const int num_hashed = max<int64_t>(
+      0, min<int64_t>(row_end, (int64_t)a_.size() - k_ + 1) - row_begin);
+  vector<unsigned long long> hashes(num_hashed);
+  RollingHasher hasher(a_, k_, char_to_id_, alphabet_size_, row_begin);
+  for (int i = 0; i < num_hashed; ++i) {
+    hasher.Next(&hashes[i]);
+  }
+  begins->resize(num_hashed);
+  ends->resize(num_hashed);
+  if (row_sampling_ > 1) {
+    // Only the sampled rows are looked up, moved to the front of hashes.
+    vector<int> sampled;
+    for (int i = 0; i < num_hashed; ++i) {
+      if (SampledRow(row_begin + i, hashes[i])) {
+        hashes[sampled.size()] = hashes[i];
+        sampled.push_back(i);
+      }
+    }
+    vector<const uint32_t*> sampled_begins(sampled.size());
+    vector<const uint32_t*> sampled_ends(sampled.size());
+    bmap_.FindBatch(hashes.data(), sampled.size(), sampled_begins.data(),
+                    sampled_ends.data());
+    fill(begins->begin(), begins->end(), nullptr);
+    fill(ends->begin(), ends->end(), nullptr);
+    for (size_t j = 0; j < sampled.size(); ++j) {
+      (*begins)[sampled[j]] = sampled_begins[j];
+      (*ends)[sampled[j]] = sampled_ends[j];
+    }
+  } else {
+    bmap_.FindBatch(hashes.data(), num_hashed, begins->data(), ends->data());
+  }
+  for (int i = 0; i < num_hashed; ++i) {
+    ClipToBand(row_begin + i, &(*begins)[i], &(*ends)[i]);
+  }
+}
+
 // static
 void PerfectHashMatchMaker::PrepareAlphabet(const std::string& a,
                                             const std::string& b,
@@ -82,13 +191,141 @@ void PerfectHashMatchMaker::PrepareAlphabet(const std::string& a,
   }
 }
 
-void PerfectHashMatchMaker::InitBMap(const std::string& b) {
-  bmap_.clear();
-  RollingHasher bhasher_(b_, k_, char_to_id_, alphabet_size_);
-  unsigned long long hash = 0;
-  for (int i = 0; i + k_ <= b.size(); ++i) {
-    assert(bhasher_.Next(&hash));
-    bmap_[hash].push_back(i);
+void PerfectHashMatchMaker::InitBMap(const std::string& b, int num_threads) {
+  bmap_.Build(b, k_, char_to_id_, alphabet_size_, num_threads);
+}
+
+void PerfectHashMatchMaker::ClipToBand(int64_t row, const uint32_t** begin,
+                                       const uint32_t** end) const {
+  if (band_width_ < 0 || *begin == *end) return;
+  // The band may reach past both ends of b.
+  const int64_t first_col = row - band_offset_ - band_width_;
+  const int64_t last_col = row - band_offset_ + band_width_;
+  *begin = lower_bound(*begin, *end, max<int64_t>(first_col, 0));
+  *end = upper_bound(*begin, *end, min<int64_t>(last_col, b_.size()));
+}
+
+vector<DiagonalRun> FindDiagonalRuns(const PerfectHashMatchMaker& match_maker,
+                                     const string& a, const string& b, int k,
+                                     int num_threads) {
+  const int num_rows = max(0, (int)a.size() - k + 1);
+  const int num_blocks = (num_rows + kRunsRowsPerBlock - 1) / kRunsRowsPerBlock;
+  vector<vector<DiagonalRun>> block_runs(num_blocks);
+  ParallelFor(num_blocks, ResolveNumThreads(num_threads), [&](int i) {
+    MatchesBlock block;
+    const int row_begin = i * kRunsRowsPerBlock;
+    match_maker.GetMatchesBlock(
+        row_begin, min(num_rows, row_begin + kRunsRowsPerBlock), &block);
+    for (int row = row_begin; row < block.row_end; ++row) {
+      const int r = row - block.row_begin;
+      for (int j = block.offsets[r]; j < block.offsets[r + 1]; ++j) {
+        const int col = block.cols[j];
+        // The match continues the run of the one before it on the diagonal.
+        if (row > 0 && col > 0 && a[row - 1] == b[col - 1]) continue;
+        int length = k;
+        while ((size_t)(row + length) < a.size() &&
+               (size_t)(col + length) < b.size() &&
+               a[row + length] == b[col + length]) {
+          ++length;
+        }
+        block_runs[i].push_back({row, col, length});
+      }
+    }
+  });
+
+  vector<DiagonalRun> runs;
+  for (const auto& some_runs : block_runs) {
+    runs.insert(runs.end(), some_runs.begin(), some_runs.end());
+  }
+  return runs;
+}
+
+RunsMatchMaker::RunsMatchMaker(const vector<DiagonalRun>& runs, int k,
+                               int num_rows)
+    : k_(k), num_rows_(num_rows), row_(0) {
+  for (const auto& run : runs) {
+    if (run.length >= k_) runs_.push_back(run);
+  }
+  const int num_buckets = num_rows / kRunsRowsPerBlock + 1;
+  bucket_offsets_.assign(num_buckets + 1, 0);
+  for (const auto& run : runs_) {
+    for (int bucket = run.row / kRunsRowsPerBlock;
+         bucket <= LastRow(run) / kRunsRowsPerBlock; ++bucket) {
+      ++bucket_offsets_[bucket + 1];
+    }
+  }
+  for (int bucket = 0; bucket < num_buckets; ++bucket) {
+    bucket_offsets_[bucket + 1] += bucket_offsets_[bucket];
+  }
+  bucket_runs_.resize(bucket_offsets_.back());
+  vector<int> next(bucket_offsets_.begin(), bucket_offsets_.end() - 1);
+  for (int i = 0; i < (int)runs_.size(); ++i) {
+    for (int bucket = runs_[i].row / kRunsRowsPerBlock;
+         bucket <= LastRow(runs_[i]) / kRunsRowsPerBlock; ++bucket) {
+      bucket_runs_[next[bucket]++] = i;
+    }
+  }
+}
+
+bool RunsMatchMaker::GetNextMatches(std::vector<int>* matches) {
+  matches->clear();
+  // Are there more matches to generate?
+  if (row_ + k_ > num_rows_) return false;
+
+  MatchesBlock block;
+  GetMatchesBlock(row_, row_ + 1, &block);
+  matches->assign(block.cols.begin(), block.cols.end());
+  ++row_;  // Not forgetting to update this!
+  return true;
+}
+
+void RunsMatchMaker::GetMatchesBlock(int64_t row_begin, int64_t row_end,
+                                     MatchesBlock* block) const {
+  block->row_begin = row_begin;
+  block->row_end = row_end;
+  block->offsets.assign(row_end - row_begin + 1, 0);
+  block->cols.clear();
+
+  // Runs reaching into the block, each one taken from the bucket of the
+  // first row it has in the block.
+  vector<int> reaching;
+  const int64_t last_bucket = min<int64_t>((row_end - 1) / kRunsRowsPerBlock,
+                                           bucket_offsets_.size() - 2);
+  for (int64_t bucket = row_begin / kRunsRowsPerBlock; bucket <= last_bucket;
+       ++bucket) {
+    for (int j = bucket_offsets_[bucket]; j < bucket_offsets_[bucket + 1];
+         ++j) {
+      const DiagonalRun& run = runs_[bucket_runs_[j]];
+      const int64_t first = max<int64_t>(row_begin, run.row);
+      if (first / kRunsRowsPerBlock == bucket && first < row_end &&
+          first <= LastRow(run)) {
+        reaching.push_back(bucket_runs_[j]);
+      }
+    }
+  }
+
+  // Matches are counted per row first and then placed into their rows.
+  for (int i : reaching) {
+    const int64_t first = max<int64_t>(row_begin, runs_[i].row);
+    const int64_t last = min<int64_t>(row_end - 1, LastRow(runs_[i]));
+    for (int64_t row = first; row <= last; ++row) {
+      ++block->offsets[row - row_begin + 1];
+    }
+  }
+  for (int r = 0; r < row_end - row_begin; ++r) {
+    block->offsets[r + 1] += block->offsets[r];
+  }
+  block->cols.resize(block->offsets.back());
+  vector<int> next(block->offsets.begin(), block->offsets.end() - 1);
+  for (int i : reaching) {
+    const int64_t first = max<int64_t>(row_begin, runs_[i].row);
+    const int64_t last = min<int64_t>(row_end - 1, LastRow(runs_[i]));
+    for (int64_t row = first; row <= last; ++row) {
+      block->cols[next[row - row_begin]++] = runs_[i].col + row - runs_[i].row;
+    }
+  }
+  for (int r = 0; r < row_end - row_begin; ++r) {
+    sort(block->cols.begin() + block->offsets[r],
+         block->cols.begin() + block->offsets[r + 1]);
   }
-  assert(!bhasher_.Next(&hash));
 }
@@ -16,17 +16,34 @@
 #define MATCH_MAKER
 
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
+#include "kmer_index.h"
 #include "rolling_hasher.h"
+#include "../util/stopwatch.h"
 
 enum MatchMakerType { NAIVE, PERFECT_HASH, };
 
+// Matches of the rows [row_begin, row_end) stored in flat buffers. Matches of
+// the row row_begin + i are cols[offsets[i]], ..., cols[offsets[i + 1] - 1].
+// Columns are stored in 32 bits, like the positions of the KmerIndex.
+struct MatchesBlock {
+  int64_t row_begin = 0;
+  int64_t row_end = 0;
+  std::vector<int> offsets;
+  std::vector<uint32_t> cols;
+};
+
 // This interface provides a single GetNextMatches method.
 // On i-th call of the of the method, it returns a vector filled
 // with indices j such that a[i,i+k) == b[j,j+k).
+//
+// Matches of any block of rows can also be generated with GetMatchesBlock.
+// It does not change the state of the match maker, so blocks can be
+// generated concurrently from several threads.
 class MatchMaker {
  public:
   MatchMaker() {}
@@ -34,9 +51,16 @@ class MatchMaker {
 
   virtual bool GetNextMatches(std::vector<int>* matches) = 0;
 
+  // Fills block with the matches of the rows [row_begin, row_end). Rows past
+  // the last length k substring of a have no matches.
+  virtual void GetMatchesBlock(int64_t row_begin, int64_t row_end,
+                               MatchesBlock* block) const = 0;
+
+  // Up to num_threads threads are used while preparing the match maker.
   static std::unique_ptr<MatchMaker> Create(const std::string& a,
                                             const std::string& b, int k,
-                                            MatchMakerType type);
+                                            MatchMakerType type,
+                                            int num_threads = 1);
 };
 
 // An implementation of the MatchMaker using brute force string
@@ -47,6 +71,8 @@ class NaiveMatchMaker : public MatchMaker {
       : a_(a), b_(b), k_(k), row_(0) {}
 
   bool GetNextMatches(std::vector<int>* matches) override;
+  void GetMatchesBlock(int64_t row_begin, int64_t row_end,
+                       MatchesBlock* block) const override;
 
  private:
   std::string a_;
@@ -61,18 +87,52 @@ class NaiveMatchMaker : public MatchMaker {
 // the lengths of these strings.
 class PerfectHashMatchMaker : public MatchMaker {
  public:
-  PerfectHashMatchMaker(const std::string& a, const std::string& b, int k) {
+  PerfectHashMatchMaker(const std::string& a, const std::string& b, int k,
+                        int num_threads = 1) {
     // TODO(fpavetic): Move the work to the Create method.
     a_ = a;
     b_ = b;
     k_ = k;
     row_ = 0;
+    Stopwatch stopwatch;
     PrepareAlphabet(a, b, char_to_id_, alphabet_size_);
     ahasher_.reset(new RollingHasher(a_, k_, char_to_id_, alphabet_size_));
-    InitBMap(b);
+    alphabet_seconds_ = stopwatch.Seconds();
+    stopwatch.Restart();
+    InitBMap(b, num_threads);
+    index_seconds_ = stopwatch.Seconds();
   }
 
   bool GetNextMatches(std::vector<int>* matches) override;
+  void GetMatchesBlock(int64_t row_begin, int64_t row_end,
+                       MatchesBlock* block) const override;
+
+  // Restricts the matches to the band of diagonals around offset: only the
+  // matches (row, col) with |row - col - offset| <= width are generated.
+  // The columns of a row are found by binary searches, so the matches out
+  // of the band cost nothing.
+  void SetBand(int64_t offset, int64_t width) {
+    band_offset_ = offset;
+    band_width_ = width;
+  }
+
+  // Samples the rows of a, see LcskppParams::row_sampling: only the matches
+  // beginning in the rows which are multiples of sampling are generated, or
+  // with by_hash the ones in the rows whose length k substring hashes to a
+  // multiple of it. The other rows are not looked up in the index at all.
+  void SetRowSampling(int sampling, bool by_hash) {
+    row_sampling_ = sampling;
+    hash_row_sampling_ = by_hash;
+  }
+
+  // Stores the number of matches of every row [row_begin, row_end) into
+  // counts, as GetMatchesBlock would generate them but without copying
+  // their columns.
+  void CountMatches(int64_t row_begin, int64_t row_end, int* counts) const;
+
+  // Time it took to prepare the alphabet and to index b, in seconds.
+  double alphabet_seconds() const { return alphabet_seconds_; }
+  double index_seconds() const { return index_seconds_; }
 
  private:
   // This function determines the total number of
@@ -85,7 +145,27 @@ class PerfectHashMatchMaker : public MatchMaker {
   // This method creates a mapping from hashes of length k
   // substrings of b to indices of those substrings. This
   // information gets stored in bmap_ member.
-  void InitBMap(const std::string& b);
+  void InitBMap(const std::string& b, int num_threads);
+
+  // Finds the positions in b of the length k substrings beginning in the
+  // rows [row_begin, row_end) of a, clipped to the band. Rows past the last
+  // length k substring of a are left out.
+  void FindRows(int64_t row_begin, int64_t row_end,
+                std::vector<const uint32_t*>* begins,
+                std::vector<const uint32_t*>* ends) const;
+
+  // True if the matches of the row, whose substring has the hash, are
+  // generated, see SetRowSampling.
+  bool SampledRow(int64_t row, unsigned long long hash) const {
+    if (row_sampling_ <= 1) return true;
+    const uint64_t key = hash_row_sampling_ ? MixHash(hash) : row;
+    return key % row_sampling_ == 0;
+  }
+
+  // Narrows the positions [*begin, *end) of a substring of b down to the
+  // ones in the band of the row.
+  void ClipToBand(int64_t row, const uint32_t** begin,
+                  const uint32_t** end) const;
 
   std::string a_;
   std::string b_;
@@ -95,7 +175,64 @@ class PerfectHashMatchMaker : public MatchMaker {
   std::vector<char> char_to_id_;
   int alphabet_size_;
   std::unique_ptr<RollingHasher> ahasher_;
-  std::unordered_map<unsigned long long, std::vector<int>> bmap_;
+  KmerIndex bmap_;
+  // Band of SetBand, a negative width means there is none.
+  int64_t band_offset_ = 0;
+  int64_t band_width_ = -1;
+  // Rows of SetRowSampling.
+  int row_sampling_ = 1;
+  bool hash_row_sampling_ = false;
+
+  double alphabet_seconds_;
+  double index_seconds_;
+};
+
+// Maximal run of matching characters along a diagonal: a[row + i] ==
+// b[col + i] for 0 <= i < length, and the run can not be extended on either
+// end.
+struct DiagonalRun {
+  int row;
+  int col;
+  int length;
+};
+
+// Finds the maximal diagonal runs of a and b which are at least k long,
+// sorted by row and col, from the matches of match_maker (built for a, b and
+// k). Only the matches beginning a run are extended, using up to num_threads
+// threads.
+std::vector<DiagonalRun> FindDiagonalRuns(
+    const PerfectHashMatchMaker& match_maker, const std::string& a,
+    const std::string& b, int k, int num_threads = 1);
+
+// An implementation of the MatchMaker reading the matches from the maximal
+// diagonal runs of a and b, as found by FindDiagonalRuns for any k' <= k. A
+// run of length L holds the matches of every k <= L, so the runs found for
+// the smallest of several ks give the matches of all of them.
+class RunsMatchMaker : public MatchMaker {
+ public:
+  // Rows are the positions in a, num_rows its length.
+  RunsMatchMaker(const std::vector<DiagonalRun>& runs, int k, int num_rows);
+
+  bool GetNextMatches(std::vector<int>* matches) override;
+  void GetMatchesBlock(int64_t row_begin, int64_t row_end,
+                       MatchesBlock* block) const override;
+
+ private:
+  // Last row of a length k match of the run.
+  int LastRow(const DiagonalRun& run) const {
+    return run.row + run.length - k_;
+  }
+
+  // Runs at least k long, sorted by row.
+  std::vector<DiagonalRun> runs_;
+  // Rows are split into buckets of a fixed number of rows. The indices of
+  // the runs with a match in bucket i are bucket_runs_[bucket_offsets_[i]],
+  // ..., bucket_runs_[bucket_offsets_[i + 1] - 1].
+  std::vector<int> bucket_offsets_;
+  std::vector<int> bucket_runs_;
+  int k_;
+  int num_rows_;
+  int row_;
 };
 
 #endif
@@ -18,20 +18,75 @@
 #include <memory>
 #include "../util/object_counter.h"
 
-struct MatchPair : ObjectCounter<MatchPair> {
+template <typename Position>
+struct MatchPair;
+
+// Positions (rows, columns and dp values) are of type Position: int for
+// strings shorter than 2^31 characters, int64_t for longer ones.
+
+// Reference to a MatchPair as it was when its dp value was equal to dp.
+// LCSk++ continuations extend a pair in place (see MatchPair), so the pair
+// may have moved on since, but the referenced state is still derived from
+// its current one.
+template <typename Position>
+struct MatchPairRef {
+  std::shared_ptr<MatchPair<Position>> pair;
+  Position dp;
+
+  MatchPairRef() : dp(0) { }
+
+  MatchPairRef(std::shared_ptr<MatchPair<Position>> pair, Position dp)
+      : pair(pair), dp(dp) { }
+
+  Position end_row() const { return pair->end_row - (pair->dp - dp); }
+  Position end_col() const { return pair->end_col - (pair->dp - dp); }
+};
+
+// A match of length k, followed by end_dp - base_dp continuations, i.e.
+// characters extending it along the same diagonal. Extending a pair in place
+// instead of creating a new one for each continuation keeps the number of
+// live pairs proportional to the number of diagonal runs in the chains.
+template <typename Position>
+struct MatchPair {
   // Needed only for the reconstruction.
-  int end_row;
+  Position end_row;
   // Needed during computation and reconstruction.
-  int end_col;
+  Position end_col;
   // Needed only for the computation.
-  int dp;
-  // Pointer to the previous match, used for reconstruction.
-  std::shared_ptr<MatchPair> prev;
+  Position dp;
+  // Value of dp before any of the continuations, needed only for the
+  // reconstruction.
+  Position base_dp;
+  // Reference to the previous match, used for reconstruction.
+  MatchPairRef<Position> prev;
 
   MatchPair() { }
 
-  MatchPair(int end_row, int end_col, int dp, std::shared_ptr<MatchPair> prev)
-      : end_row(end_row), end_col(end_col), dp(dp), prev(prev) { }
+  MatchPair(Position end_row, Position end_col, Position dp,
+            const MatchPairRef<Position>& prev)
+      : end_row(end_row), end_col(end_col), dp(dp), base_dp(dp), prev(prev) { }
+
+  // Extends the pair by one continuation.
+  void Continue() {
+    ++end_row;
+    ++end_col;
+    ++dp;
+  }
 };
 
+// Creates a MatchPair counted by counter. Building with LCSK_NO_COUNTERS
+// compiles the counting out, counter is ignored then.
+template <typename Position>
+inline std::shared_ptr<MatchPair<Position>> MakeMatchPair(
+    ObjectCounter* counter, Position end_row, Position end_col, Position dp,
+    const MatchPairRef<Position>& prev) {
+#ifdef LCSK_NO_COUNTERS
+  return std::make_shared<MatchPair<Position>>(end_row, end_col, dp, prev);
+#else
+  return std::allocate_shared<MatchPair<Position>>(
+      CountingAllocator<MatchPair<Position>>(counter), end_row, end_col, dp,
+      prev);
+#endif
+}
+
 #endif
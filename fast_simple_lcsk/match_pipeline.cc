@@ -0,0 +1,108 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "match_pipeline.h"
+
+#include <algorithm>
+
+#include "../util/stopwatch.h"
+
+using namespace std;
+
+MatchPipeline::MatchPipeline(const MatchMaker& match_maker, int64_t num_rows,
+                             int block_size, int num_threads)
+    : match_maker_(match_maker),
+      num_rows_(num_rows),
+      block_size_(block_size),
+      num_blocks_((num_rows + block_size - 1) / block_size),
+      next_produced_(0),
+      next_consumed_(0),
+      generation_seconds_(0) {
+  // The consumer is one of the threads, the rest of them generate blocks.
+  const int num_producers = min(num_threads - 1, num_blocks_);
+  slots_.resize(max(1, 2 * num_producers));
+  ready_.assign(slots_.size(), -1);
+  for (int i = 0; i < num_producers; ++i) {
+    producers_.emplace_back(&MatchPipeline::Produce, this);
+  }
+}
+
+MatchPipeline::~MatchPipeline() { Stop(); }
+
+void MatchPipeline::Stop() {
+  {
+    // Producers waiting for a free slot are released by skipping the
+    // blocks nobody is going to consume.
+    lock_guard<mutex> lock(mutex_);
+    next_consumed_ = num_blocks_;
+  }
+  slot_free_.notify_all();
+  for (auto& producer : producers_) {
+    producer.join();
+  }
+  producers_.clear();
+}
+
+const MatchesBlock* MatchPipeline::Next() {
+  if (producers_.empty()) {
+    if (next_consumed_ == num_blocks_) return nullptr;
+    Stopwatch stopwatch;
+    Fill(next_consumed_++, &slots_[0]);
+    generation_seconds_ += stopwatch.Seconds();
+    return &slots_[0];
+  }
+
+  unique_lock<mutex> lock(mutex_);
+  if (next_consumed_ > 0) {
+    // The block handed out by the previous call is not needed anymore.
+    ready_[(next_consumed_ - 1) % slots_.size()] = -1;
+    slot_free_.notify_all();
+  }
+  if (next_consumed_ == num_blocks_) return nullptr;
+
+  const int slot = next_consumed_ % slots_.size();
+  block_ready_.wait(lock, [&] { return ready_[slot] == next_consumed_; });
+  ++next_consumed_;
+  return &slots_[slot];
+}
+
+void MatchPipeline::Produce() {
+  unique_lock<mutex> lock(mutex_);
+  while (next_produced_ < num_blocks_) {
+    const int block_index = next_produced_++;
+    const int slot = block_index % slots_.size();
+    // The slot is free once the block which used it before was consumed.
+    slot_free_.wait(lock, [&] {
+      return next_consumed_ >= num_blocks_ ||
+             (block_index < next_consumed_ + (int)slots_.size() &&
+              ready_[slot] == -1);
+    });
+    if (next_consumed_ >= num_blocks_) return;
+
+    lock.unlock();
+    Stopwatch stopwatch;
+    Fill(block_index, &slots_[slot]);
+    const double seconds = stopwatch.Seconds();
+    lock.lock();
+    generation_seconds_ += seconds;
+    ready_[slot] = block_index;
+    block_ready_.notify_all();
+  }
+}
+
+void MatchPipeline::Fill(int block_index, MatchesBlock* block) const {
+  const int64_t row_begin = (int64_t)block_index * block_size_;
+  const int64_t row_end = min(num_rows_, row_begin + block_size_);
+  match_maker_.GetMatchesBlock(row_begin, row_end, block);
+}
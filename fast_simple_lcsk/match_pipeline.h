@@ -0,0 +1,77 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MATCH_PIPELINE
+#define MATCH_PIPELINE
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "match_maker.h"
+
+// Hands out the matches of the rows [0, num_rows) block by block, in row
+// order. With more than one thread the blocks are generated by background
+// threads, a bounded number of blocks ahead of the consumer, so the
+// generation overlaps with whatever the consumer does with the blocks.
+class MatchPipeline {
+ public:
+  MatchPipeline(const MatchMaker& match_maker, int64_t num_rows,
+                int block_size, int num_threads);
+  ~MatchPipeline();
+
+  // Returns the next block, or nullptr once all of the rows were handed out.
+  // The block stays valid until the following call.
+  const MatchesBlock* Next();
+
+  // Stops generating blocks and joins the background threads, Next returns
+  // nullptr from then on. For consumers which stop before the last block.
+  void Stop();
+
+  // Number of blocks Next hands out.
+  int num_blocks() const { return num_blocks_; }
+
+  // Time spent generating the blocks, summed over the threads which
+  // generated them, in seconds. Valid once Next returned nullptr or after
+  // Stop.
+  double generation_seconds() const { return generation_seconds_; }
+
+ private:
+  void Produce();
+  void Fill(int block_index, MatchesBlock* block) const;
+
+  const MatchMaker& match_maker_;
+  const int64_t num_rows_;
+  const int block_size_;
+  const int num_blocks_;
+
+  // Blocks in flight, block i is generated into slots_[i % slots_.size()].
+  std::vector<MatchesBlock> slots_;
+  // ready_[slot] is the index of the block which is ready in the slot.
+  std::vector<int> ready_;
+  // Index of the next block to be generated by a producer.
+  int next_produced_;
+  // Index of the next block to be handed out to the consumer.
+  int next_consumed_;
+  double generation_seconds_;
+
+  std::mutex mutex_;
+  std::condition_variable block_ready_;
+  std::condition_variable slot_free_;
+  std::vector<std::thread> producers_;
+};
+
+#endif  // MATCH_PIPELINE
@@ -0,0 +1,256 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "dense_dp.h"
+#include "rolling_hasher.h"
+
+using namespace std;
+
+namespace {
+
+// Upper bounds on the number of buckets of the histogram of b and on the
+// number of substrings of a looked up in it.
+const int kMaxHistogramBits = 16;
+const int kMaxSamples = 4096;
+// Base of the polynomial hash of the substrings.
+const uint64_t kHashBase = 0x100000001b3ULL;
+// Expected number of substrings of b sampled by EstimateBand and the number
+// of unique matches it needs.
+const int kBandSamples = 4096;
+const int kMinBandAnchors = 16;
+// Substrings shorter than this are rarely unique in long strings, the band
+// is estimated from longer ones then.
+const int kMinBandAnchorLength = 16;
+// Margin of the band, in diagonals.
+const int kMinBandMargin = 32;
+
+// Cost model, fitted to the runs of bench_scaling and of the dense engine on
+// short mutated reads. The sparse engine pays per character of the strings
+// (alphabet, index and hashing) and per match, the dense one per cell.
+const double kCallSeconds = 10e-6;
+const double kSparseSecondsPerChar = 60e-9;
+const double kSparseSecondsPerMatch = 150e-9;
+const double kDenseSecondsPerCell = 0.75e-9;
+// Memory of the index per character of b and of a MatchPair.
+const uint64_t kIndexBytesPerChar = 32;
+const uint64_t kMatchPairBytes = 64;
+
+// Hashes of the length k substrings of s, in order, passed to visit.
+template <typename Visit>
+void ForEachKmerHash(const string& s, int k, const Visit& visit) {
+  if (s.size() < (size_t)k) return;
+  uint64_t top = 1;
+  for (int i = 0; i < k; ++i) {
+    top *= kHashBase;
+  }
+  uint64_t hash = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    hash = hash * kHashBase + (unsigned char)s[i];
+    if (i >= (size_t)k) {
+      hash -= top * (unsigned char)s[i - k];
+    }
+    if (i + 1 >= (size_t)k) {
+      visit(i + 1 - k, hash);
+    }
+  }
+}
+
+// Estimates the number of matches of a against b. Every sampled substring of
+// a adds the count of its bucket in the histogram of b, less the count the
+// bucket gets from the substrings of b colliding with it.
+uint64_t EstimateMatches(const string& a, const string& b, int k) {
+  const int a_kmers = max(0, (int)a.size() - k + 1);
+  const int b_kmers = max(0, (int)b.size() - k + 1);
+  if (a_kmers == 0 || b_kmers == 0) return 0;
+
+  int bits = 1;
+  while (bits < kMaxHistogramBits && (1 << bits) < 2 * b_kmers) {
+    ++bits;
+  }
+  auto bucket = [bits](uint64_t hash) {
+    return MixHash(hash) >> (64 - bits);
+  };
+  vector<uint32_t> histogram(1 << bits, 0);
+  ForEachKmerHash(b, k, [&](int, uint64_t hash) { ++histogram[bucket(hash)]; });
+
+  const int stride = max(1, a_kmers / kMaxSamples);
+  double sum = 0;
+  int samples = 0;
+  ForEachKmerHash(a, k, [&](int position, uint64_t hash) {
+    if (position % stride == 0) {
+      sum += histogram[bucket(hash)];
+      ++samples;
+    }
+  });
+  const double collisions = (double)samples * b_kmers / histogram.size();
+  return max(0.0, sum - collisions) * a_kmers / samples;
+}
+
+// Expected number of matches of a and b if their characters were
+// independent, with the frequencies they have.
+double RandomMatches(const string& a, const string& b, int k) {
+  if (a.size() < (size_t)k || b.size() < (size_t)k) return 0;
+  vector<double> a_count(256, 0);
+  vector<double> b_count(256, 0);
+  for (char c : a) ++a_count[(unsigned char)c];
+  for (char c : b) ++b_count[(unsigned char)c];
+  double match_probability = 0;
+  for (int c = 0; c < 256; ++c) {
+    match_probability += a_count[c] / a.size() * b_count[c] / b.size();
+  }
+  return pow(match_probability, k) * (a.size() - k + 1) * (b.size() - k + 1);
+}
+
+}  // namespace
+
+bool EstimateBand(const string& a, const string& b, int k, int* offset,
+                  int* width) {
+  *offset = 0;
+  *width = max(a.size(), b.size());
+  k = max(k, kMinBandAnchorLength);
+  const int b_kmers = max(0, (int)b.size() - k + 1);
+  if (b_kmers == 0) return false;
+  // Substrings whose mixed hash is at most limit are sampled.
+  const double fraction = min(1.0, (double)kBandSamples / b_kmers);
+  const uint64_t limit =
+      fraction >= 1 ? ~0ULL : (uint64_t)(fraction * 18446744073709551616.0);
+
+  // Positions of the sampled substrings in b and in a, -1 for the repeated
+  // ones. Repeats of either string would put matches far from the band.
+  unordered_map<uint64_t, pair<int, int>> positions;
+  ForEachKmerHash(b, k, [&](int position, uint64_t hash) {
+    if (MixHash(hash) <= limit) {
+      auto inserted = positions.emplace(hash, make_pair(position, -2));
+      if (!inserted.second) inserted.first->second.first = -1;
+    }
+  });
+  ForEachKmerHash(a, k, [&](int position, uint64_t hash) {
+    if (MixHash(hash) <= limit) {
+      auto it = positions.find(hash);
+      if (it != positions.end()) {
+        it->second.second = it->second.second == -2 ? position : -1;
+      }
+    }
+  });
+  vector<int> diagonals;
+  for (const auto& entry : positions) {
+    const pair<int, int>& position = entry.second;
+    if (position.first >= 0 && position.second >= 0) {
+      diagonals.push_back(position.second - position.first);
+    }
+  }
+  if (diagonals.size() < kMinBandAnchors) return false;
+
+  sort(diagonals.begin(), diagonals.end());
+  const int outliers = diagonals.size() / 100;
+  const int low = diagonals[outliers];
+  const int high = diagonals[diagonals.size() - 1 - outliers];
+  *offset = low + (high - low) / 2;
+  *width = (high - low + 1) / 2 + kMinBandMargin + (high - low) / 8;
+  return true;
+}
+
+const EngineEstimate& LcskppPlan::chosen() const {
+  for (const auto& estimate : estimates) {
+    if (estimate.engine == engine) return estimate;
+  }
+  static const EngineEstimate kUnknown{LcskppParams::Engine::AUTO, 0, 0};
+  return kUnknown;
+}
+
+LcskppPlan PlanLcskpp(const string& a, const string& b,
+                      const LcskppParams& params) {
+  LcskppPlan plan;
+  plan.estimated_matches = EstimateMatches(a, b, params.k);
+  const double n = a.size();
+  const double m = b.size();
+  const double matches = plan.estimated_matches;
+  // Runs on reversed b are assumed to cost as much as the one on b.
+  const int directions = params.reverse ? 2 : 1;
+
+  // Multistart modes run the sparse dp several times over (subsets of) the
+  // matches and keep all of them in memory.
+  double dp_runs = 1;
+  uint64_t pair_bytes = kMatchPairBytes * min(matches, n);
+  switch (params.mode) {
+    case LcskppParams::Mode::SINGLESTART:
+      break;
+    case LcskppParams::Mode::MULTISTART_2D_LOGARITHMIC:
+      // Both of the halvings are geometric series.
+      dp_runs = 4;
+      pair_bytes = kMatchPairBytes * matches;
+      break;
+    case LcskppParams::Mode::MULTISTART_AGGRESSIVE:
+      dp_runs = params.aggressive_runs;
+      pair_bytes = kMatchPairBytes * matches;
+      break;
+  }
+  plan.estimates.push_back(EngineEstimate{
+      LcskppParams::Engine::SPARSE,
+      directions * (kCallSeconds + kSparseSecondsPerChar * (n + m) +
+                    kSparseSecondsPerMatch * matches * dp_runs),
+      kIndexBytesPerChar * (uint64_t)m + pair_bytes});
+
+  if (params.mode == LcskppParams::Mode::SINGLESTART && FitsDense(a, b)) {
+    const double cells = (n + 1) * (m + 1);
+    plan.estimates.push_back(EngineEstimate{
+        LcskppParams::Engine::DENSE,
+        directions * (kCallSeconds + kDenseSecondsPerCell * cells),
+        (uint64_t)(2 * sizeof(uint16_t) * cells)});
+  }
+
+  if (params.mode == LcskppParams::Mode::SINGLESTART &&
+      (params.band_width >= 0 ||
+       params.engine == LcskppParams::Engine::BANDED)) {
+    plan.band_offset = params.band_offset;
+    plan.band_width = params.band_width;
+    if (plan.band_width < 0) {
+      EstimateBand(a, b, params.k, &plan.band_offset, &plan.band_width);
+    }
+    // Matches expected between unrelated strings with the same character
+    // frequencies are spread over all of the diagonals, the rest are
+    // assumed to be in the band.
+    const double width = 2.0 * plan.band_width + 1;
+    const double random = min(matches, RandomMatches(a, b, params.k));
+    const double band_matches =
+        matches - random + random * min(1.0, width / max(m, 1.0));
+    plan.estimates.push_back(EngineEstimate{
+        LcskppParams::Engine::BANDED,
+        directions * (kCallSeconds + kSparseSecondsPerChar * (n + m) +
+                      kSparseSecondsPerMatch * band_matches),
+        kIndexBytesPerChar * (uint64_t)m +
+            (uint64_t)(kMatchPairBytes * min(band_matches, width + params.k))});
+  }
+
+  // A forced engine which is not able to run the call is ignored.
+  for (const auto& estimate : plan.estimates) {
+    if (estimate.engine == params.engine) {
+      plan.engine = params.engine;
+      return plan;
+    }
+  }
+  plan.engine = min_element(plan.estimates.begin(), plan.estimates.end(),
+                            [](const EngineEstimate& x,
+                               const EngineEstimate& y) {
+                              return x.seconds < y.seconds;
+                            })->engine;
+  return plan;
+}
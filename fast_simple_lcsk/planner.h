@@ -0,0 +1,71 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef PLANNER
+#define PLANNER
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lcsk.h"
+
+// Predicted cost of running a call on one of the engines.
+struct EngineEstimate {
+  LcskppParams::Engine engine;
+  double seconds;
+  uint64_t bytes;
+};
+
+// Engine a call runs on and the estimates it was chosen by.
+struct LcskppPlan {
+  LcskppParams::Engine engine = LcskppParams::Engine::SPARSE;
+  // Estimated number of matches of a against b (not reversed).
+  uint64_t estimated_matches = 0;
+  // Estimates of the engines which are able to run the call.
+  std::vector<EngineEstimate> estimates;
+  // Band of the BANDED engine for the run on b (not reversed), if it is
+  // among the estimates.
+  int band_offset = 0;
+  int band_width = -1;
+
+  // Estimate of the chosen engine. Plans which were not made by PlanLcskpp
+  // have no estimates, they get a zero one of the AUTO engine.
+  const EngineEstimate& chosen() const;
+};
+
+// Estimates the band of diagonals the LCSk of a and b stays in from the
+// unique matches of a sample of their length k substrings (at least 16
+// characters long, whatever k is): the ones whose
+// hashes fall into a fixed part of the hash range, so that all of the
+// occurrences of a sampled substring are sampled. The band covers 98% of
+// the matches of the substrings occurring once in b, plus a margin for the
+// indels between them. If there are too few of them to tell, the band
+// covers all of the diagonals and false is returned.
+bool EstimateBand(const std::string& a, const std::string& b, int k,
+                  int* offset, int* width);
+
+// Estimates the number of matches from a histogram of the length k
+// substrings of b (hashed into a bounded number of buckets) and a sample of
+// the ones of a, which takes time linear in the length of b. The predicted
+// time and memory of every engine follow from it and the lengths of the
+// strings. Unless params.engine forces one which is able to run the call,
+// the engine with the smallest predicted time is chosen. The BANDED engine
+// is only considered if it is forced or params.band_width is set, otherwise
+// its result may be shorter than the one of the other engines.
+LcskppPlan PlanLcskpp(const std::string& a, const std::string& b,
+                      const LcskppParams& params);
+
+#endif  // PLANNER
@@ -0,0 +1,44 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reference.h"
+
+#include <algorithm>
+
+using namespace std;
+
+LcskppReference::LcskppReference(const string& b, const LcskppParams& params)
+    : b_(b), k_(params.k) {
+  vector<char> b_char_to_id(256, -1);
+  alphabet_size_ = 0;
+  for (unsigned char c : b_) {
+    if (b_char_to_id[c] == -1) {
+      b_char_to_id[c] = alphabet_size_++;
+    }
+  }
+  // The extra id shared by the characters not in b.
+  const char other_id = alphabet_size_++;
+  char_to_id_.assign(256, other_id);
+  for (int c = 0; c < 256; ++c) {
+    if (b_char_to_id[c] != -1) char_to_id_[c] = b_char_to_id[c];
+  }
+
+  index_.Build(b_, k_, char_to_id_, alphabet_size_, params.num_threads);
+  if (params.reverse) {
+    string b_reversed = b_;
+    reverse(b_reversed.begin(), b_reversed.end());
+    reversed_index_.Build(b_reversed, k_, char_to_id_, alphabet_size_,
+                          params.num_threads);
+  }
+}
@@ -0,0 +1,53 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef REFERENCE
+#define REFERENCE
+
+#include <string>
+#include <vector>
+
+#include "kmer_index.h"
+#include "lcsk.h"
+
+// The string b of LcskppSparseFast, indexed up front so that strings a can
+// be compared against it without knowing them in advance.
+//
+// The alphabet is determined by b alone. Characters which do not appear in
+// b all get the same extra id, length k substrings containing it do not
+// match anything in b.
+class LcskppReference {
+ public:
+  // The index is built for params.k. If params.reverse is set, reversed b is
+  // indexed too.
+  LcskppReference(const std::string& b, const LcskppParams& params);
+
+  const std::string& b() const { return b_; }
+  int k() const { return k_; }
+  const std::vector<char>& char_to_id() const { return char_to_id_; }
+  int alphabet_size() const { return alphabet_size_; }
+  const KmerIndex& index() const { return index_; }
+  // Index of reversed b, empty unless params.reverse was set.
+  const KmerIndex& reversed_index() const { return reversed_index_; }
+
+ private:
+  std::string b_;
+  int k_;
+  std::vector<char> char_to_id_;
+  int alphabet_size_;
+  KmerIndex index_;
+  KmerIndex reversed_index_;
+};
+
+#endif  // REFERENCE
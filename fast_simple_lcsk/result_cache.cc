@@ -0,0 +1,376 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "result_cache.h"
+
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+#include "rolling_hasher.h"
+#include "../util/parallel.h"
+
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = {'L', 'C', 'S', 'K', 'R', 'E', 'S', '2'};
+// Every run takes at least a byte for each of its three varints.
+const uint64_t kMinRunBytes = 3;
+// Memory taken by an entry besides its runs: the list and map nodes.
+const uint64_t kEntryOverhead = 128;
+
+inline uint64_t Rotl(uint64_t x, int bits) {
+  return (x << bits) | (x >> (64 - bits));
+}
+
+// MurmurHash3_x64_128 over the data added, in any number of pieces.
+class Hasher128 {
+ public:
+  Hasher128() : h1_(0), h2_(0), size_(0), buffered_(0) {}
+
+  void Add(const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    size_ += size;
+    if (buffered_ > 0) {
+      const size_t taken = min(size, 16 - buffered_);
+      memcpy(buffer_ + buffered_, bytes, taken);
+      buffered_ += taken;
+      bytes += taken;
+      size -= taken;
+      if (buffered_ < 16) return;
+      Block(buffer_);
+      buffered_ = 0;
+    }
+    for (; size >= 16; bytes += 16, size -= 16) {
+      Block(bytes);
+    }
+    memcpy(buffer_, bytes, size);
+    buffered_ = size;
+  }
+
+  template <typename T>
+  void AddValue(T value) {
+    Add(&value, sizeof(value));
+  }
+
+  // Strings are prefixed by their length, so that the pieces can not be
+  // shifted between them.
+  void AddString(const string& s) {
+    AddValue((uint64_t)s.size());
+    Add(s.data(), s.size());
+  }
+
+  LcskppCacheKey Finish() {
+    uint64_t k1 = 0, k2 = 0;
+    for (int i = buffered_ - 1; i >= 8; --i) {
+      k2 = (k2 << 8) | (unsigned char)buffer_[i];
+    }
+    for (int i = min<int>(buffered_, 8) - 1; i >= 0; --i) {
+      k1 = (k1 << 8) | (unsigned char)buffer_[i];
+    }
+    h1_ ^= Rotl(k1 * kC1, 31) * kC2;
+    h2_ ^= Rotl(k2 * kC2, 33) * kC1;
+
+    h1_ ^= size_;
+    h2_ ^= size_;
+    h1_ += h2_;
+    h2_ += h1_;
+    h1_ = MixHash(h1_);
+    h2_ = MixHash(h2_);
+    h1_ += h2_;
+    h2_ += h1_;
+    return {h1_, h2_};
+  }
+
+ private:
+  static const uint64_t kC1 = 0x87c37b91114253d5ULL;
+  static const uint64_t kC2 = 0x4cf5ad432745937fULL;
+
+  void Block(const char* bytes) {
+    uint64_t k1, k2;
+    memcpy(&k1, bytes, 8);
+    memcpy(&k2, bytes + 8, 8);
+    h1_ ^= Rotl(k1 * kC1, 31) * kC2;
+    h1_ = (Rotl(h1_, 27) + h2_) * 5 + 0x52dce729;
+    h2_ ^= Rotl(k2 * kC2, 33) * kC1;
+    h2_ = (Rotl(h2_, 31) + h1_) * 5 + 0x38495ab5;
+  }
+
+  uint64_t h1_;
+  uint64_t h2_;
+  uint64_t size_;
+  char buffer_[16];
+  size_t buffered_;
+};
+
+uint64_t EntryBytes(const LcskppResult& result) {
+  return kEntryOverhead + result.runs.size() * sizeof(LcskppRun);
+}
+
+void WriteVarint(ostream& out, uint64_t value) {
+  char bytes[10];
+  int size = 0;
+  do {
+    bytes[size++] = (value & 0x7f) | (value >= 0x80 ? 0x80 : 0);
+    value >>= 7;
+  } while (value > 0);
+  out.write(bytes, size);
+}
+
+bool ReadVarint(istream& in, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    const int byte = in.get();
+    if (byte == EOF) return false;
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+}
+
+// Differences of signed values, small ones of either sign in few bytes.
+uint64_t ZigZag(int64_t value) {
+  return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+int64_t UnZigZag(uint64_t value) {
+  return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Checksum of a cached result file, stored at its end.
+uint64_t Checksum(const string& data) {
+  Hasher128 hasher;
+  hasher.Add(data.data(), data.size());
+  return hasher.Finish().low;
+}
+
+template <typename T>
+void Write(ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool Read(istream& in, T* value) {
+  return (bool)in.read(reinterpret_cast<char*>(value), sizeof(*value));
+}
+
+}  // namespace
+
+LcskppCacheKey LcskppCallKey(const string& a, const string& b,
+                             const LcskppParams& params) {
+  Hasher128 hasher;
+  hasher.AddString(a);
+  hasher.AddString(b);
+  // Fields added to LcskppParams which change the result belong here too.
+  hasher.AddValue((int32_t)params.lcsk_plus);
+  hasher.AddValue((int32_t)params.reverse);
+  hasher.AddValue((int32_t)params.mode);
+  hasher.AddValue((int32_t)params.k);
+  hasher.AddValue((int32_t)params.aggressive_runs);
+  hasher.AddValue((int32_t)params.engine);
+  // Sparse runs on long strings split the dp between the threads (see
+  // wavefront_dp.h), which may pick another chain of the same length.
+  hasher.AddValue((int32_t)ResolveNumThreads(params.num_threads));
+  hasher.AddValue((int32_t)params.band_width);
+  hasher.AddValue((int32_t)params.band_offset);
+  hasher.AddValue((int32_t)params.min_score);
+  hasher.AddValue((int32_t)params.position_bits);
+  hasher.AddValue((int32_t)params.row_sampling);
+  hasher.AddValue((int32_t)params.hash_row_sampling);
+  return hasher.Finish();
+}
+
+string LcskppCachePath(const string& directory, const LcskppCacheKey& key) {
+  char name[40];
+  snprintf(name, sizeof(name), "%016" PRIx64 "%016" PRIx64 ".lcskpp",
+           key.high, key.low);
+  return directory + "/" + name;
+}
+
+bool SaveCachedResult(const string& path, const LcskppCacheKey& key,
+                      const LcskppResult& result) {
+  ostringstream encoded;
+  encoded.write(kMagic, sizeof(kMagic));
+  Write(encoded, key.low);
+  Write(encoded, key.high);
+  Write(encoded, result.estimated_size);
+  Write(encoded, result.upper_bound);
+  Write(encoded, (uint64_t)result.runs.size());
+  // Runs are sorted, so their starts are written as differences to the
+  // previous run. The direction is the lowest bit of the length.
+  LcskppRun previous = {0, 0, 0, false};
+  for (const auto& run : result.runs) {
+    WriteVarint(encoded, run.a_start - previous.a_start);
+    WriteVarint(encoded, ZigZag(run.b_start - previous.b_start));
+    WriteVarint(encoded, (uint64_t)run.length << 1 | run.reverse);
+    previous = run;
+  }
+  const string data = encoded.str();
+  const uint64_t checksum = Checksum(data);
+
+  // The file is written next to its final path and renamed there, so that
+  // readers never see it half-written, even if two processes write it.
+  string temp_path = path + ".XXXXXX";
+  const int fd = mkstemp(&temp_path[0]);
+  if (fd < 0) return false;
+  close(fd);
+  ofstream out(temp_path, ios::binary);
+  out.write(data.data(), data.size());
+  Write(out, checksum);
+  if (!out.flush()) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  out.close();
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LoadCachedResult(const string& path, const LcskppCacheKey& key,
+                      LcskppResult* result) {
+  ifstream file(path, ios::binary);
+  if (!file) return false;
+  string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+  uint64_t checksum;
+  if (data.size() < sizeof(checksum)) return false;
+  memcpy(&checksum, data.data() + data.size() - sizeof(checksum),
+         sizeof(checksum));
+  data.resize(data.size() - sizeof(checksum));
+  if (Checksum(data) != checksum) return false;
+
+  istringstream in(data);
+  char magic[sizeof(kMagic)];
+  if (!in.read(magic, sizeof(magic)) ||
+      memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  LcskppCacheKey file_key;
+  LcskppResult loaded;
+  uint64_t num_runs;
+  if (!Read(in, &file_key.low) || !Read(in, &file_key.high) ||
+      !(file_key == key) || !Read(in, &loaded.estimated_size) ||
+      !Read(in, &loaded.upper_bound) || !Read(in, &num_runs) ||
+      num_runs > data.size() / kMinRunBytes) {
+    return false;
+  }
+  loaded.runs.reserve(num_runs);
+  LcskppRun run = {0, 0, 0, false};
+  for (uint64_t i = 0; i < num_runs; ++i) {
+    uint64_t a_delta, b_delta, length;
+    if (!ReadVarint(in, &a_delta) || !ReadVarint(in, &b_delta) ||
+        !ReadVarint(in, &length)) {
+      return false;
+    }
+    run.a_start += a_delta;
+    run.b_start += UnZigZag(b_delta);
+    run.length = length >> 1;
+    run.reverse = length & 1;
+    loaded.runs.push_back(run);
+  }
+  // All of the runs were read and nothing follows them.
+  if (in.peek() != EOF) return false;
+  *result = move(loaded);
+  return true;
+}
+
+LcskppResultCache::LcskppResultCache(uint64_t max_bytes,
+                                     const string& directory)
+    : max_bytes_(max_bytes), directory_(directory) {}
+
+LcskppResult LcskppResultCache::Runs(const string& a, const string& b,
+                                     const LcskppParams& params,
+                                     LcskppStats* stats) {
+  const LcskppCacheKey key = LcskppCallKey(a, b, params);
+  LcskppResult result;
+  if (FindInMemory(key, &result)) {
+    if (stats != nullptr) *stats = LcskppStats();
+    return result;
+  }
+  const string path =
+      directory_.empty() ? "" : LcskppCachePath(directory_, key);
+  if (!path.empty() && LoadCachedResult(path, key, &result)) {
+    {
+      lock_guard<mutex> lock(mutex_);
+      ++counters_.disk_hits;
+    }
+    Insert(key, result);
+    if (stats != nullptr) *stats = LcskppStats();
+    return result;
+  }
+
+  result = LcskppSparseFastRuns(a, b, params, stats);
+  {
+    lock_guard<mutex> lock(mutex_);
+    ++counters_.misses;
+  }
+  if (!result.partial && !result.invalid_params) {
+    Insert(key, result);
+    if (!path.empty() && !SaveCachedResult(path, key, result)) {
+      fprintf(stderr, "Cannot write %s\n", path.c_str());
+    }
+  }
+  return result;
+}
+
+vector<pair<int, int>> LcskppResultCache::Pairs(const string& a,
+                                                const string& b,
+                                                const LcskppParams& params,
+                                                LcskppStats* stats) {
+  return Runs(a, b, params, stats).ToPairs();
+}
+
+LcskppCacheCounters LcskppResultCache::counters() const {
+  lock_guard<mutex> lock(mutex_);
+  return counters_;
+}
+
+bool LcskppResultCache::FindInMemory(const LcskppCacheKey& key,
+                                     LcskppResult* result) {
+  lock_guard<mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) return false;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  *result = it->second->result;
+  ++counters_.hits;
+  return true;
+}
+
+void LcskppResultCache::Insert(const LcskppCacheKey& key,
+                               const LcskppResult& result) {
+  const uint64_t bytes = EntryBytes(result);
+  if (bytes > max_bytes_) return;
+  lock_guard<mutex> lock(mutex_);
+  // Another thread may have inserted it in the meantime.
+  if (index_.count(key)) return;
+  entries_.push_front({key, result, bytes});
+  index_[key] = entries_.begin();
+  counters_.bytes += bytes;
+  while (counters_.bytes > max_bytes_) {
+    counters_.bytes -= entries_.back().bytes;
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  counters_.entries = entries_.size();
+}
+
@@ -0,0 +1,120 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef RESULT_CACHE
+#define RESULT_CACHE
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "lcsk.h"
+
+// 128-bit hash of a call: of a, b and the fields of LcskppParams a complete
+// result depends on, the number of threads (0 resolved to the number of
+// cores) included. The budgets and the cancel token are left out, they only
+// decide whether the result is partial.
+struct LcskppCacheKey {
+  uint64_t low;
+  uint64_t high;
+
+  bool operator==(const LcskppCacheKey& other) const {
+    return low == other.low && high == other.high;
+  }
+};
+
+LcskppCacheKey LcskppCallKey(const std::string& a, const std::string& b,
+                             const LcskppParams& params);
+
+// Counters of a LcskppResultCache, since it was created.
+struct LcskppCacheCounters {
+  // Calls answered from memory, from the directory and computed.
+  uint64_t hits = 0;
+  uint64_t disk_hits = 0;
+  uint64_t misses = 0;
+  // Results kept in memory and the bytes they take.
+  uint64_t entries = 0;
+  uint64_t bytes = 0;
+};
+
+// Memoizes LcskppSparseFastRuns for workloads which compare the same pairs
+// again, a repeated call costs hashing the strings and a lookup.
+//
+// Results are kept in memory, the least recently used ones are dropped once
+// they take more than max_bytes. If a directory is given, every computed
+// result is also stored there in a file named after its key, and the calls
+// missing in memory look there before computing it, so the results outlive
+// the process. Partial and invalid results are not cached, a cached result
+// is a complete one. Safe to use from several threads; calls computing the
+// same missing result at the same time compute it each.
+class LcskppResultCache {
+ public:
+  explicit LcskppResultCache(uint64_t max_bytes,
+                             const std::string& directory = "");
+
+  // Same as LcskppSparseFastRuns. The stats are the ones of the computation
+  // for a miss and empty (LcskppStats()) for a hit.
+  LcskppResult Runs(const std::string& a, const std::string& b,
+                    const LcskppParams& params, LcskppStats* stats = nullptr);
+  // Same as LcskppSparseFast.
+  std::vector<std::pair<int, int>> Pairs(const std::string& a,
+                                         const std::string& b,
+                                         const LcskppParams& params,
+                                         LcskppStats* stats = nullptr);
+
+  LcskppCacheCounters counters() const;
+
+ private:
+  struct KeyHash {
+    size_t operator()(const LcskppCacheKey& key) const { return key.low; }
+  };
+  struct Entry {
+    LcskppCacheKey key;
+    LcskppResult result;
+    uint64_t bytes;
+  };
+
+  // Moves the entry to the front of the LRU list and copies its result.
+  bool FindInMemory(const LcskppCacheKey& key, LcskppResult* result);
+  void Insert(const LcskppCacheKey& key, const LcskppResult& result);
+
+  const uint64_t max_bytes_;
+  const std::string directory_;
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<LcskppCacheKey, std::list<Entry>::iterator, KeyHash>
+      index_;
+  LcskppCacheCounters counters_;
+};
+
+// File of the result of a call in the directory of a LcskppResultCache.
+std::string LcskppCachePath(const std::string& directory,
+                            const LcskppCacheKey& key);
+
+// Run-compressed binary format of a result, with the key of the call so a
+// file can be checked against the call, and a checksum. Save writes a
+// temporary file and renames it to the path, so a file at the path is
+// always complete. Load returns false on an I/O or format error, a wrong
+// checksum, missing or trailing bytes, or if the key differs.
+bool SaveCachedResult(const std::string& path, const LcskppCacheKey& key,
+                      const LcskppResult& result);
+bool LoadCachedResult(const std::string& path, const LcskppCacheKey& key,
+                      LcskppResult* result);
+
+#endif  // RESULT_CACHE
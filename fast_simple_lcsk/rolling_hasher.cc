@@ -15,13 +15,13 @@
 #include "rolling_hasher.h"
 
 bool RollingHasher::Next(unsigned long long* hash) {
-  if (col_ + k_ > s_.size()) {
+  if (col_ + k_ > (int64_t)s_.size()) {
     return false;
   }
 
-  if (col_ == 0) {
+  if (col_ == start_) {
     hash_ = 0;
-    for (int i = 0; i < k_ - 1; ++i) {
+    for (int64_t i = start_; i < start_ + k_ - 1; ++i) {
       hash_ = hash_ * alphabet_size_ + char_to_id_[s_[i]];
     }
   }
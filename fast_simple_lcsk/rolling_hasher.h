@@ -15,18 +15,23 @@
 #ifndef ROLLING_HASHER
 #define ROLLING_HASHER
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 class RollingHasher {
  public:
+  // Hashes the length k substrings of s which begin at positions start,
+  // start + 1, ... in that order.
   RollingHasher(const std::string& s, int k,
-                const std::vector<char>& char_to_id, int alphabet_size)
+                const std::vector<char>& char_to_id, int alphabet_size,
+                int64_t start = 0)
       : s_(s),
         k_(k),
         char_to_id_(char_to_id),
         alphabet_size_(alphabet_size),
-        col_(0) {
+        start_(start),
+        col_(start) {
     hash_mod_ = 1;
     for (int i = 0; i < k; ++i) {
       hash_mod_ *= alphabet_size;
@@ -41,10 +46,22 @@ class RollingHasher {
   int k_;
   const std::vector<char>& char_to_id_;
   int alphabet_size_;
+  int64_t start_;
 
   unsigned long long hash_mod_;
   unsigned long long hash_;
-  int col_;
+  int64_t col_;
 };
 
+// The perfect hashes of similar substrings are close to each other, the
+// finalizer of MurmurHash3 spreads them over the whole 64-bit range.
+inline uint64_t MixHash(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
 #endif  // ROLLING_HASHER
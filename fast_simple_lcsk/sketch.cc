@@ -0,0 +1,266 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sketch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+#include "rolling_hasher.h"
+#include "../util/parallel.h"
+
+using namespace std;
+
+namespace {
+
+const char kMagic[8] = {'L', 'C', 'S', 'K', 'S', 'K', 'T', '1'};
+// Loaded hashes are read in chunks, so that the memory taken by a corrupted
+// file is bounded by its size, not by the number of hashes it claims.
+const size_t kLoadChunkHashes = 1 << 16;
+
+// True if alphabet_size^k fits into 64 bits.
+bool FitsHash(int k, int alphabet_size) {
+  unsigned long long hash_mod = 1;
+  for (int i = 0; i < k; ++i) {
+    if (hash_mod > ULLONG_MAX / alphabet_size) return false;
+    hash_mod *= alphabet_size;
+  }
+  return true;
+}
+
+// Sorts the hashes, drops the repeated ones and keeps at most size of them.
+void Compact(vector<uint64_t>* hashes, size_t size) {
+  sort(hashes->begin(), hashes->end());
+  hashes->erase(unique(hashes->begin(), hashes->end()), hashes->end());
+  if (hashes->size() > size) hashes->resize(size);
+}
+
+template <typename T>
+void Write(ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool Read(istream& in, T* value) {
+  return (bool)in.read(reinterpret_cast<char*>(value), sizeof(*value));
+}
+
+}  // namespace
+
+Sketch::Sketch(const string& s, const SketchParams& params)
+    : params_(params), num_kmers_(max(0, (int)s.size() - params.k + 1)) {
+  const int alphabet_size = params.alphabet.size() + 1;
+  assert(params.k > 0 && FitsHash(params.k, alphabet_size));
+  assert(params.sketch_size > 0 || params.scale > 0);
+  vector<char> char_to_id(256, alphabet_size - 1);
+  for (int i = 0; i < (int)params.alphabet.size(); ++i) {
+    char_to_id[(unsigned char)params.alphabet[i]] = i;
+  }
+
+  RollingHasher hasher(s, params.k, char_to_id, alphabet_size);
+  unsigned long long hash;
+  if (params.sketch_size > 0) {
+    // Hashes above the largest one of the smallest sketch_size seen so far
+    // are dropped right away, the rest is compacted once in a while.
+    const size_t size = params.sketch_size;
+    uint64_t limit = UINT64_MAX;
+    while (hasher.Next(&hash)) {
+      const uint64_t mixed = MixHash(hash);
+      if (mixed > limit) continue;
+      hashes_.push_back(mixed);
+      if (hashes_.size() >= 2 * size) {
+        Compact(&hashes_, size);
+        if (hashes_.size() == size) limit = hashes_.back();
+      }
+    }
+    Compact(&hashes_, size);
+  } else {
+    const uint64_t limit = MaxHash();
+    while (hasher.Next(&hash)) {
+      const uint64_t mixed = MixHash(hash);
+      if (mixed <= limit) hashes_.push_back(mixed);
+    }
+    Compact(&hashes_, hashes_.size());
+  }
+}
+
+uint64_t Sketch::MaxHash() const {
+  if (params_.sketch_size > 0) {
+    return (int)hashes_.size() == params_.sketch_size ? hashes_.back()
+                                                      : UINT64_MAX;
+  }
+  return UINT64_MAX / params_.scale;
+}
+
+double Sketch::Containment(const Sketch& other) const {
+  assert(params_ == other.params_);
+  const uint64_t limit = min(MaxHash(), other.MaxHash());
+  auto end = upper_bound(hashes_.begin(), hashes_.end(), limit);
+  if (end == hashes_.begin()) return 0;
+
+  int shared = 0;
+  auto other_it = other.hashes_.begin();
+  for (auto it = hashes_.begin(); it != end; ++it) {
+    while (other_it != other.hashes_.end() && *other_it < *it) ++other_it;
+    if (other_it == other.hashes_.end()) break;
+    if (*other_it == *it) ++shared;
+  }
+  return (double)shared / (end - hashes_.begin());
+}
+
+bool Sketch::Save(ostream& out) const {
+  out.write(kMagic, sizeof(kMagic));
+  Write(out, (int32_t)params_.k);
+  Write(out, (int32_t)params_.scale);
+  Write(out, (int32_t)params_.sketch_size);
+  Write(out, (int32_t)params_.alphabet.size());
+  out.write(params_.alphabet.data(), params_.alphabet.size());
+  Write(out, (int32_t)num_kmers_);
+  Write(out, (uint64_t)hashes_.size());
+  out.write(reinterpret_cast<const char*>(hashes_.data()),
+            hashes_.size() * sizeof(uint64_t));
+  return (bool)out;
+}
+
+bool Sketch::Load(istream& in) {
+  char magic[sizeof(kMagic)];
+  if (!in.read(magic, sizeof(magic)) ||
+      memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+  int32_t k, scale, sketch_size, alphabet_size, num_kmers;
+  uint64_t num_hashes;
+  if (!Read(in, &k) || !Read(in, &scale) || !Read(in, &sketch_size) ||
+      !Read(in, &alphabet_size) || alphabet_size < 0 || alphabet_size > 255 ||
+      k <= 0 || !FitsHash(k, alphabet_size + 1)) {
+    return false;
+  }
+  // FracMinHash sketches divide by their scale, see MaxHash.
+  if (sketch_size <= 0 && scale <= 0) return false;
+  string alphabet(alphabet_size, 0);
+  if (!in.read(&alphabet[0], alphabet_size) || !Read(in, &num_kmers) ||
+      !Read(in, &num_hashes) || num_hashes > (uint64_t)max(0, num_kmers)) {
+    return false;
+  }
+  vector<uint64_t> hashes;
+  while (hashes.size() < num_hashes) {
+    const size_t read = hashes.size();
+    const size_t chunk = min<uint64_t>(kLoadChunkHashes, num_hashes - read);
+    hashes.resize(read + chunk);
+    if (!in.read(reinterpret_cast<char*>(&hashes[read]),
+                 chunk * sizeof(uint64_t))) {
+      return false;
+    }
+  }
+  // Containment merges the hashes, they have to be sorted and distinct.
+  if (adjacent_find(hashes.begin(), hashes.end(),
+                    greater_equal<uint64_t>()) != hashes.end()) {
+    return false;
+  }
+
+  params_.k = k;
+  params_.scale = scale;
+  params_.sketch_size = sketch_size;
+  params_.alphabet = alphabet;
+  num_kmers_ = num_kmers;
+  hashes_.swap(hashes);
+  return true;
+}
+
+string SketchPath(const string& sequence_path) {
+  return sequence_path + ".sketch";
+}
+
+bool SaveSketch(const Sketch& sketch, const string& path) {
+  ofstream out(path, ios::binary);
+  return sketch.Save(out) && (bool)out.flush();
+}
+
+bool LoadSketch(const string& path, Sketch* sketch) {
+  ifstream in(path, ios::binary);
+  return in && sketch->Load(in);
+}
+
+vector<SketchCandidate> FindCandidatePairs(const vector<Sketch>& sketches,
+                                           double min_containment,
+                                           int num_threads) {
+  const int n = sketches.size();
+  vector<pair<uint64_t, int>> inverted;
+  if (min_containment > 0) {
+    for (int i = 0; i < n; ++i) {
+      for (uint64_t hash : sketches[i].hashes()) {
+        inverted.emplace_back(hash, i);
+      }
+    }
+    sort(inverted.begin(), inverted.end());
+  }
+
+  vector<vector<SketchCandidate>> found(n);
+  ParallelFor(n, ResolveNumThreads(num_threads), [&](int i) {
+    // Sketches j > i sharing a hash with sketch i.
+    vector<int> others;
+    if (min_containment > 0) {
+      for (uint64_t hash : sketches[i].hashes()) {
+        auto it = upper_bound(inverted.begin(), inverted.end(),
+                              make_pair(hash, i));
+        for (; it != inverted.end() && it->first == hash; ++it) {
+          others.push_back(it->second);
+        }
+      }
+      sort(others.begin(), others.end());
+      others.erase(unique(others.begin(), others.end()), others.end());
+    } else {
+      for (int j = i + 1; j < n; ++j) others.push_back(j);
+    }
+
+    for (int j : others) {
+      const double containment =
+          max(sketches[i].Containment(sketches[j]),
+              sketches[j].Containment(sketches[i]));
+      if (containment >= min_containment) {
+        found[i].push_back({i, j, containment});
+      }
+    }
+  });
+
+  vector<SketchCandidate> candidates;
+  for (const auto& pairs : found) {
+    candidates.insert(candidates.end(), pairs.begin(), pairs.end());
+  }
+  return candidates;
+}
+
+vector<SketchCandidateResult> LcskppCandidatePairs(
+    const vector<string>& sequences, const vector<Sketch>& sketches,
+    double min_containment, const LcskppParams& params) {
+  assert(sequences.size() == sketches.size());
+  const vector<SketchCandidate> candidates =
+      FindCandidatePairs(sketches, min_containment, params.num_threads);
+
+  LcskppParams pair_params = params;
+  pair_params.num_threads = 1;
+  vector<SketchCandidateResult> results(candidates.size());
+  ParallelFor(candidates.size(), ResolveNumThreads(params.num_threads),
+              [&](int index) {
+                const SketchCandidate& pair = candidates[index];
+                results[index].pair = pair;
+                results[index].result = LcskppSparseFastRuns(
+                    sequences[pair.i], sequences[pair.j], pair_params);
+              });
+  return results;
+}
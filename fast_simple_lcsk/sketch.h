@@ -0,0 +1,125 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SKETCH
+#define SKETCH
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "lcsk.h"
+
+// Sketches of the length k substrings (k-mers) of sequences, for estimating
+// how much of them two sequences share without comparing them. An all-vs-all
+// job sketches every sequence once and computes LCSk++ only for the pairs
+// whose sketches are similar enough (see LcskppCandidatePairs).
+//
+// The k-mers are hashed by the RollingHasher over a fixed alphabet, so that
+// the hashes of different sequences can be compared, and the hashes mixed
+// before they are sampled.
+struct SketchParams {
+  SketchParams() = default;
+
+  int k = 16;
+  // Characters which are not in the alphabet all get the same extra id.
+  // alphabet_size^k (the extra character included) has to fit into 64 bits.
+  std::string alphabet = "ACGT";
+  // FracMinHash: about one in scale of the distinct k-mers is kept, the ones
+  // whose mixed hash is at most 2^64 / scale.
+  int scale = 1000;
+  // If positive, the sketch is a bottom-s MinHash of the sketch_size
+  // smallest mixed hashes instead, and scale is ignored.
+  int sketch_size = 0;
+
+  bool operator==(const SketchParams& other) const {
+    return k == other.k && alphabet == other.alphabet &&
+           scale == other.scale && sketch_size == other.sketch_size;
+  }
+  bool operator!=(const SketchParams& other) const {
+    return !(*this == other);
+  }
+};
+
+class Sketch {
+ public:
+  Sketch() : num_kmers_(0) {}
+  Sketch(const std::string& s, const SketchParams& params);
+
+  // Estimated fraction of the distinct k-mers of this sequence which are
+  // k-mers of the other one too. Both have to be built with the same params.
+  // Bottom-s sketches are compared on the hashes below the largest hash both
+  // of them would have kept.
+  double Containment(const Sketch& other) const;
+
+  // Binary format with the params, so a loaded sketch can be checked against
+  // the params of the job. Both return false on an I/O or format error.
+  bool Save(std::ostream& out) const;
+  bool Load(std::istream& in);
+
+  const SketchParams& params() const { return params_; }
+  // Number of the k-mers of the sequence, repeated ones included.
+  int num_kmers() const { return num_kmers_; }
+  // Sorted distinct mixed hashes kept in the sketch.
+  const std::vector<uint64_t>& hashes() const { return hashes_; }
+
+ private:
+  // Every hash of the sequence at most this one is in the sketch.
+  uint64_t MaxHash() const;
+
+  SketchParams params_;
+  int num_kmers_;
+  std::vector<uint64_t> hashes_;
+};
+
+// Sketches are persisted next to the sequence they were built from, in
+// sequence_path + ".sketch".
+std::string SketchPath(const std::string& sequence_path);
+bool SaveSketch(const Sketch& sketch, const std::string& path);
+bool LoadSketch(const std::string& path, Sketch* sketch);
+
+// Pair of sequences i < j whose sketches passed the cutoff. containment is
+// the larger one of the two directions, so a short sequence contained in a
+// long one passes too.
+struct SketchCandidate {
+  int i;
+  int j;
+  double containment;
+};
+
+// Pairs of the sketches with containment at least min_containment, sorted.
+// Only the pairs sharing a hash are compared: the hashes of all of the
+// sketches are sorted into an inverted index first. A non-positive
+// min_containment passes all of the pairs. Uses up to num_threads threads,
+// 0 means one per hardware core.
+std::vector<SketchCandidate> FindCandidatePairs(
+    const std::vector<Sketch>& sketches, double min_containment,
+    int num_threads = 1);
+
+struct SketchCandidateResult {
+  SketchCandidate pair;
+  LcskppResult result;
+};
+
+// LCSk++ (LcskppSparseFastRuns) of the candidate pairs of sequences, with
+// sequences[pair.i] as a. The pairs are computed in parallel on
+// params.num_threads threads, one thread per pair.
+std::vector<SketchCandidateResult> LcskppCandidatePairs(
+    const std::vector<std::string>& sequences,
+    const std::vector<Sketch>& sketches, double min_containment,
+    const LcskppParams& params);
+
+#endif  // SKETCH
@@ -0,0 +1,355 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "sparse_dp.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "../util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+template <typename Position>
+bool CompareByCol(const TableEntry<Position>& a, Position end_col) {
+  return a.end_col < end_col;
+}
+
+}  // namespace
+
+void RecordRowMatches(int num_matches, LcskppStats* stats) {
+  stats->num_matches += num_matches;
+  int bucket = 0;
+  while (num_matches >> bucket) {
+    ++bucket;
+  }
+  if (stats->row_match_histogram.size() <= (size_t)bucket) {
+    stats->row_match_histogram.resize(bucket + 1);
+  }
+  ++stats->row_match_histogram[bucket];
+}
+
+template <typename Position>
+vector<LcskppRun> FillLcskReconstruction(const int k,
+                                         const MatchPairRef<Position>& best) {
+  vector<LcskppRun> runs;
+  // Adds the length characters ending at (r, c), in front of the ones added
+  // so far.
+  auto add = [&runs](Position r, Position c, Position length) {
+    if (!runs.empty() && runs.back().a_start == r + 1 &&
+        runs.back().b_start == c + 1) {
+      runs.back().a_start -= length;
+      runs.back().b_start -= length;
+      runs.back().length += length;
+    } else {
+      runs.push_back(LcskppRun{r - length + 1, c - length + 1, length, false});
+    }
+  };
+
+  for (auto ft = best; ft.pair != nullptr; ft = ft.pair->prev) {
+    const MatchPairRef<Position>& prev = ft.pair->prev;
+    // Continuations the pair was extended by.
+    Position continuations = ft.dp - ft.pair->base_dp;
+    Position r = ft.end_row() - continuations;
+    Position c = ft.end_col() - continuations;
+
+    if (prev.pair == nullptr ||
+        (prev.end_row() + k <= r && prev.end_col() + k <= c)) {
+      add(ft.end_row(), ft.end_col(), continuations + k);
+    } else {
+      assert(prev.end_row() + 1 == r && prev.end_col() + 1 == c);
+      add(ft.end_row(), ft.end_col(), continuations + 1);
+    }
+  }
+  reverse(runs.begin(), runs.end());
+  return runs;
+}
+
+template <typename Position>
+void RowUpdate(
+    const int k, const Position row, MatchEventsQueue<Position>* events_ptr,
+    vector<TableEntry<Position>>* compressed_table_ptr,
+    vector<MatchPairRef<Position>>* prev_row_match_pairs,
+    bool lcsk_plus, Position table_base, Position first_col) {
+  auto& events = *events_ptr;
+  auto& compressed_table = *compressed_table_ptr;
+  auto& prev_row = *prev_row_match_pairs;
+
+  typename MatchEventsQueue<Position>::Event event;
+
+  vector<MatchPairRef<Position>> curr_row;
+  size_t curr_continuation_index = 0;
+
+  while (events.PopEnd(row, &event)) {
+    Position i = get<0>(event);
+    Position j = get<1>(event);
+    assert(i == row);
+    MatchPairRef<Position> match_pair_end(get<2>(event), get<2>(event)->dp);
+
+    if (lcsk_plus) { // LCSk++
+      while (curr_continuation_index < prev_row.size() &&
+             prev_row[curr_continuation_index].end_col() + 1 < j) {
+        curr_continuation_index++;
+      }
+
+      if (curr_continuation_index < prev_row.size() &&
+          prev_row[curr_continuation_index].end_col() + 1 == j) {
+        const MatchPairRef<Position>& continued =
+            prev_row[curr_continuation_index];
+        if (continued.dp + 1 >= match_pair_end.dp && j <= first_col) {
+          // The continued pair belongs to the stripe on the left, which may
+          // still be using it, so the new pair is linked to it instead.
+          auto& pair = match_pair_end.pair;
+          pair->dp = pair->base_dp = continued.dp + 1;
+          pair->prev = continued;
+          match_pair_end.dp = pair->dp;
+        } else if (continued.dp + 1 >= match_pair_end.dp) {
+          // Instead of linking the new pair to the one ending in the
+          // previous row, the latter is extended and the new one dropped.
+          assert(continued.dp == continued.pair->dp);
+          continued.pair->Continue();
+          match_pair_end =
+              MatchPairRef<Position>(continued.pair, continued.pair->dp);
+        }
+      }
+
+      curr_row.emplace_back(match_pair_end);
+
+      Position dp = match_pair_end.dp;
+      while (table_base + (Position)compressed_table.size() <= dp) {
+        // fill with dummy values which will be overwritten in for loop below anyway.
+        Position idx = table_base + compressed_table.size();
+        compressed_table.push_back(TableEntry<Position>{nullptr, idx, j + 1});
+      }
+
+      // Pruned entries end left of j, so the loop stops at table_base at
+      // the latest.
+      for (Position idx = dp; idx > dp - k && idx >= table_base &&
+                              j < compressed_table[idx - table_base].end_col;
+           --idx) {
+        compressed_table[idx - table_base] =
+            TableEntry<Position>{match_pair_end.pair, dp, j};
+      }
+    } else { // LCSk
+      // The first entry ends left of the match (see Prune and SetLeft), so
+      // the match extends at least it and lands right of table_base.
+      Position idx = match_pair_end.dp / k - table_base;
+      assert(idx >= 0);
+      TableEntry<Position> entry{match_pair_end.pair, match_pair_end.dp, j};
+      if (idx == (Position)compressed_table.size()) {
+        compressed_table.emplace_back(entry);
+      } else if (j < compressed_table[idx].end_col) {
+        compressed_table[idx] = entry;
+      }
+    }
+  }
+
+  prev_row.swap(curr_row);
+}
+
+template <typename Position>
+void AmortizedRowQuery(
+    const int k, const Position row, MatchEventsQueue<Position>* events_ptr,
+    vector<TableEntry<Position>>* compressed_table_ptr,
+    ObjectCounter* match_pairs) {
+  auto& events = *events_ptr;
+  auto& compressed_table = *compressed_table_ptr;
+
+  size_t curr_threshold_index = 0;
+  typename MatchEventsQueue<Position>::Event event;
+
+  while (events.PopBegin(row, &event)) {
+    Position i = get<0>(event);
+    Position j = get<1>(event);
+    assert(i == row);
+    while (curr_threshold_index < compressed_table.size() &&
+           compressed_table[curr_threshold_index].end_col < j) {
+      ++curr_threshold_index;
+    }
+
+    const TableEntry<Position>& prev_best =
+        compressed_table[curr_threshold_index - 1];
+    Position dp = k;
+    MatchPairRef<Position> prev;
+    if (prev_best.dp > 0) {
+      dp = prev_best.dp + k;
+      prev = prev_best.ref();
+    }
+    auto match_pair =
+        MakeMatchPair(match_pairs, i + k - 1, j + k - 1, dp, prev);
+    events.AddEnd(make_tuple(i + k - 1, j + k - 1, match_pair));
+  }
+}
+
+template <typename Position>
+void ElementwiseRowQuery(
+    const int k, const Position row, MatchEventsQueue<Position>* events_ptr,
+    vector<TableEntry<Position>>* compressed_table_ptr,
+    ObjectCounter* match_pairs) {
+  auto& events = *events_ptr;
+  auto& compressed_table = *compressed_table_ptr;
+
+  typename MatchEventsQueue<Position>::Event event;
+
+  while (events.PopBegin(row, &event)) {
+    Position i = get<0>(event);
+    Position j = get<1>(event);
+    assert(i == row);
+
+    auto prev_best =
+      lower_bound(compressed_table.begin(), compressed_table.end(),
+                  j, CompareByCol<Position>) -
+      1;
+    Position dp = k;
+    MatchPairRef<Position> prev;
+    if (prev_best->dp > 0) {
+      dp = prev_best->dp + k;
+      prev = prev_best->ref();
+    }
+    auto match_pair =
+        MakeMatchPair(match_pairs, i + k - 1, j + k - 1, dp, prev);
+    events.AddEnd(make_tuple(i + k - 1, j + k - 1, match_pair));
+  }
+}
+
+template <typename Position>
+void SparseDp<Position>::Prune(Position min_col) {
+  // Entries ending left of min_col are all dominated by the last of them,
+  // which stays as the first entry. They are erased once they make up half
+  // of the table, so every entry is moved O(1) times on average.
+  const Position last_dominated =
+      lower_bound(compressed_table_.begin(), compressed_table_.end(), min_col,
+                  CompareByCol<Position>) -
+      compressed_table_.begin() - 1;
+  if (last_dominated > 0 &&
+      2 * last_dominated >= (Position)compressed_table_.size()) {
+    compressed_table_.erase(compressed_table_.begin(),
+                            compressed_table_.begin() + last_dominated);
+    table_base_ += last_dominated;
+  }
+}
+
+template <typename Position>
+void SparseDp<Position>::ProcessRow(Position row, const uint32_t* cols_begin,
+                                    const uint32_t* cols_end) {
+  if (band_width_ >= 0) {
+    // Matches of this row and the following ones begin at this column or
+    // right of it.
+    Prune(row - band_offset_ - band_width_);
+  }
+
+  for (const uint32_t* col = cols_begin; col != cols_end; ++col) {
+    events_.AddBegin(Event(row, *col, nullptr));
+  }
+
+  int table_row_size = compressed_table_.size();
+  int num_begin_events = cols_end - cols_begin;
+  bool use_amortized_row_update = (table_row_size + num_begin_events <
+                                   6 * num_begin_events * log(table_row_size) / log(2));
+
+  if (use_amortized_row_update) {
+    AmortizedRowQuery(k_, row, &events_, &compressed_table_, match_pairs_);
+    ++stats_->amortized_rows;
+  } else {
+    ElementwiseRowQuery(k_, row, &events_, &compressed_table_,
+                        match_pairs_);
+    ++stats_->elementwise_rows;
+  }
+
+  RowUpdate(k_, row, &events_, &compressed_table_, &prev_row_match_pairs_,
+            lcsk_plus_, table_base_, begin_col_);
+}
+
+template <typename Position>
+void SparseDp<Position>::SetLeft(const StripeRow<Position>& left) {
+  const Position index = lcsk_plus_ ? left.best.dp : left.best.dp / k_;
+  if (index > floor_index_) {
+    // The entries up to the index are dominated by the best entry of the
+    // left, which ends left of all of the matches here. The best entries
+    // of the earlier rows are not sorted by their columns, but as they all
+    // end left of the matches the queries still find the last of them.
+    while (table_base_ + (Position)compressed_table_.size() <= index) {
+      compressed_table_.push_back(left.best);
+    }
+    for (Position idx = floor_index_ + 1; idx <= index; ++idx) {
+      compressed_table_[idx - table_base_] = left.best;
+    }
+    floor_index_ = index;
+    // Same as in Prune, only the last of them is needed.
+    const Position dominated = index - table_base_;
+    if (2 * dominated >= (Position)compressed_table_.size()) {
+      compressed_table_.erase(compressed_table_.begin(),
+                              compressed_table_.begin() + dominated);
+      table_base_ = index;
+    }
+  }
+  if (left.last.pair != nullptr) {
+    // It ends left of all of the matches of the row.
+    prev_row_match_pairs_.insert(prev_row_match_pairs_.begin(), left.last);
+  }
+}
+
+template <typename Position>
+StripeRow<Position> SparseDp<Position>::Right() const {
+  StripeRow<Position> right;
+  right.best = compressed_table_.back();
+  if (!prev_row_match_pairs_.empty() &&
+      prev_row_match_pairs_.back().end_col() == end_col_ - 1) {
+    right.last = prev_row_match_pairs_.back();
+  }
+  return right;
+}
+
+template <typename Position>
+vector<LcskppRun> SparseDp<Position>::Reconstruction() const {
+  Stopwatch stopwatch;
+  stats_->compressed_table_size =
+      max(stats_->compressed_table_size, (uint64_t)compressed_table_.size());
+  auto runs = FillLcskReconstruction(k_, compressed_table_.back().ref());
+  stats_->reconstruction_seconds += stopwatch.Seconds();
+  return runs;
+}
+
+template class SparseDp<int>;
+template class SparseDp<int64_t>;
+template vector<LcskppRun> FillLcskReconstruction(int k,
+                                                  const MatchPairRef<int>&);
+template vector<LcskppRun> FillLcskReconstruction(
+    int k, const MatchPairRef<int64_t>&);
+template void RowUpdate(int k, int row, MatchEventsQueue<int>* events,
+                        vector<TableEntry<int>>* compressed_table,
+                        vector<MatchPairRef<int>>* prev_row_match_pairs,
+                        bool lcsk_plus, int table_base, int first_col);
+template void RowUpdate(int k, int64_t row, MatchEventsQueue<int64_t>* events,
+                        vector<TableEntry<int64_t>>* compressed_table,
+                        vector<MatchPairRef<int64_t>>* prev_row_match_pairs,
+                        bool lcsk_plus, int64_t table_base,
+                        int64_t first_col);
+template void AmortizedRowQuery(int k, int row, MatchEventsQueue<int>* events,
+                                vector<TableEntry<int>>* compressed_table,
+                                ObjectCounter* match_pairs);
+template void AmortizedRowQuery(int k, int64_t row,
+                                MatchEventsQueue<int64_t>* events,
+                                vector<TableEntry<int64_t>>* compressed_table,
+                                ObjectCounter* match_pairs);
+template void ElementwiseRowQuery(int k, int row,
+                                  MatchEventsQueue<int>* events,
+                                  vector<TableEntry<int>>* compressed_table,
+                                  ObjectCounter* match_pairs);
+template void ElementwiseRowQuery(
+    int k, int64_t row, MatchEventsQueue<int64_t>* events,
+    vector<TableEntry<int64_t>>* compressed_table, ObjectCounter* match_pairs);
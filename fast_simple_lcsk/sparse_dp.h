@@ -0,0 +1,194 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPARSE_DP
+#define SPARSE_DP
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+#include "lcsk.h"
+#include "lcsk_result.h"
+#include "match_events_queue.h"
+#include "match_pair.h"
+#include "../util/object_counter.h"
+
+// The sparse dynamic programming behind LcskppSparseFast. Rows of the match
+// matrix are processed one by one: first the dp values of the matches
+// beginning in the row are queried from the compressed table (by one of the
+// two RowQuery functions), then the matches ending in the row update it.
+
+// Adds a row with num_matches matches to the statistics. Used by the dense
+// engine too, so both of them fill the row histogram the same way.
+void RecordRowMatches(int num_matches, LcskppStats* stats);
+
+// Everything below is defined for Position int and int64_t, see
+// match_pair.h.
+
+// Entry of the compressed table: the pair as it was when its dp value was
+// equal to dp and its end column to end_col.
+template <typename Position>
+struct TableEntry {
+  std::shared_ptr<MatchPair<Position>> pair;
+  Position dp;
+  Position end_col;
+
+  MatchPairRef<Position> ref() const {
+    return MatchPairRef<Position>(pair, dp);
+  }
+};
+
+// Runs of the reconstruction ending with best. The pairs of the chain are
+// taken along their diagonals, so a pair and the one it continues end up in
+// a single run.
+template <typename Position>
+std::vector<LcskppRun> FillLcskReconstruction(
+    int k, const MatchPairRef<Position>& best);
+
+// Updates the compressed table with the matches ending in the row. With
+// lcsk_plus they are also linked to (or extend in place) the matches ending
+// in the previous row, which prev_row_match_pairs holds on the way in and
+// is replaced by the ones of this row on the way out. The first table_base
+// entries of the table were pruned (see SparseDp::set_band). Pairs ending
+// left of first_col belong to another stripe (see SparseDp::set_stripe),
+// they are linked to instead of extended.
+template <typename Position>
+void RowUpdate(int k, Position row, MatchEventsQueue<Position>* events,
+               std::vector<TableEntry<Position>>* compressed_table,
+               std::vector<MatchPairRef<Position>>* prev_row_match_pairs,
+               bool lcsk_plus, Position table_base = 0,
+               Position first_col = 0);
+
+// Creates the MatchPairs of the matches beginning in the row and schedules
+// their end events. The amortized version walks over the compressed table
+// once, the elementwise one binary searches it for every match.
+template <typename Position>
+void AmortizedRowQuery(int k, Position row,
+                       MatchEventsQueue<Position>* events,
+                       std::vector<TableEntry<Position>>* compressed_table,
+                       ObjectCounter* match_pairs);
+template <typename Position>
+void ElementwiseRowQuery(int k, Position row,
+                         MatchEventsQueue<Position>* events,
+                         std::vector<TableEntry<Position>>* compressed_table,
+                         ObjectCounter* match_pairs);
+
+// What a stripe of the wavefront dp hands to the stripe on its right after
+// processing a row.
+template <typename Position>
+struct StripeRow {
+  // Best entry among the matches ending in the row or above it, left of the
+  // stripe on the right.
+  TableEntry<Position> best{nullptr, 0, -1};
+  // The match ending in the row, in the last column left of the stripe on
+  // the right, if there is one.
+  MatchPairRef<Position> last;
+};
+
+// State of the sparse dynamic programming over the rows of the match
+// matrix. Rows have to be processed in increasing order, starting at 0.
+template <typename Position>
+class SparseDp {
+ public:
+  typedef typename MatchEventsQueue<Position>::Event Event;
+
+  // Statistics of the dp are added to stats and the MatchPairs it creates
+  // counted by match_pairs.
+  SparseDp(int k, bool lcsk_plus, LcskppStats* stats,
+           ObjectCounter* match_pairs)
+      : k_(k), lcsk_plus_(lcsk_plus), stats_(stats),
+        match_pairs_(match_pairs) {
+    compressed_table_.push_back(TableEntry<Position>{nullptr, 0, -1});
+  }
+
+  // Promises that all of the matches (row, col) satisfy
+  // |row - col - offset| <= width. The entries of the compressed table left
+  // of the band are then pruned, keeping it at O(width + k) entries.
+  void set_band(Position offset, Position width) {
+    band_offset_ = offset;
+    band_width_ = width;
+  }
+
+  // Restricts the dp to the matches beginning in the columns
+  // [begin_col, end_col) of a stripe of the match matrix, which has to be at
+  // least k columns wide. Matches beginning left of the stripe and ending in
+  // it are received from the stripe on the left (see Receive), together
+  // with a StripeRow for every row (see SetLeft), and the ones of this stripe
+  // ending right of it are passed on (see passed).
+  void set_stripe(Position begin_col, Position end_col) {
+    begin_col_ = begin_col;
+    end_col_ = end_col;
+    events_.passed_col = end_col;
+  }
+
+  // Adds the end event of a match passed by the stripe on the left. They
+  // have to be received in the order they were passed, before their row is
+  // processed.
+  void Receive(const Event& event) { events_.received.push(event); }
+
+  // Sets what the stripe on the left handed over after processing the last
+  // row processed here.
+  void SetLeft(const StripeRow<Position>& left);
+
+  // Returns what this stripe hands over to the stripe on the right after
+  // the last processed row.
+  StripeRow<Position> Right() const;
+
+  // End events of the matches to be passed to the stripe on the right, in
+  // order. The caller takes them out.
+  std::queue<Event>* passed() { return &events_.passed; }
+
+  // Processes the row given the columns of the matches beginning in it,
+  // in increasing order.
+  void ProcessRow(Position row, const uint32_t* cols_begin,
+                  const uint32_t* cols_end);
+
+  std::vector<LcskppRun> Reconstruction() const;
+
+  // Number of entries of the compressed table.
+  int table_size() const { return compressed_table_.size(); }
+
+  // Length of the best chain of the matches ending in the processed rows.
+  Position best_score() const { return compressed_table_.back().dp; }
+
+ private:
+  // Drops the entries which no match beginning at min_col or right of it
+  // can be chained to.
+  void Prune(Position min_col);
+
+  const int k_;
+  const bool lcsk_plus_;
+  LcskppStats* stats_;
+  ObjectCounter* match_pairs_;
+  MatchEventsQueue<Position> events_;
+  // following invariants hold:
+  //    LCSk++: compressed_table_[i].dp == i
+  //    LCSk:   compressed_table_[i].dp == k*i
+  // where i counts the pruned entries too, table_base_ of them.
+  std::vector<TableEntry<Position>> compressed_table_;
+  Position table_base_ = 0;
+  Position band_offset_ = 0;
+  Position band_width_ = -1;
+  Position begin_col_ = 0;
+  Position end_col_ = 0;
+  // The entries up to this one (counting the pruned ones) are the best
+  // entry of the stripes on the left, see SetLeft.
+  Position floor_index_ = 0;
+  std::vector<MatchPairRef<Position>> prev_row_match_pairs_;
+};
+
+#endif  // SPARSE_DP
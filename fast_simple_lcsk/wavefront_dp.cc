@@ -0,0 +1,208 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "wavefront_dp.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+#include "sparse_dp.h"
+#include "../util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+// Stripes narrower than this are not worth a thread of their own.
+const int kMinStripeCols = 1 << 12;
+
+// What a stripe handed over for a block of rows.
+template <typename Position>
+struct StripeBlock {
+  // One for every row of the block.
+  vector<StripeRow<Position>> rows;
+  vector<typename MatchEventsQueue<Position>::Event> passed;
+};
+
+// A block of rows in flight.
+template <typename Position>
+struct WavefrontSlot {
+  MatchesBlock matches;
+  // One for every stripe.
+  vector<StripeBlock<Position>> stripes;
+};
+
+}  // namespace
+
+int NumWavefrontStripes(int64_t num_cols, int k, int num_threads) {
+  return max<int64_t>(
+      1, min<int64_t>(num_threads / 2, num_cols / max(k, kMinStripeCols)));
+}
+
+template <typename Position>
+vector<LcskppRun> WavefrontLcskpp(int k, bool lcsk_plus, Position num_cols,
+                                  int num_stripes, MatchPipeline* pipeline,
+                                  CallBudget* budget, LcskppStats* stats,
+                                  ObjectCounter* match_pairs) {
+  Stopwatch stopwatch;
+  const int num_blocks = pipeline->num_blocks();
+  // Block i goes to slots[i % slots.size()], the first stripe fills it once
+  // the last one is done with the block which used it before.
+  vector<WavefrontSlot<Position>> slots(2 * num_stripes);
+  for (auto& slot : slots) {
+    slot.stripes.resize(num_stripes);
+  }
+  // done[s] is the number of blocks stripe s is done with.
+  vector<int> done(num_stripes, 0);
+  // Once the budget expires, the first stripe sets the number of blocks
+  // and the row at which all of the stripes stop.
+  int num_blocks_left = num_blocks;
+  Position stop_row = numeric_limits<Position>::max();
+  mutex done_mutex;
+  condition_variable block_done;
+
+  vector<LcskppStats> stripe_stats(num_stripes);
+  vector<int> table_sizes(num_stripes);
+  vector<LcskppRun> recon;
+
+  auto process_stripe = [&](int s) {
+    const Position begin_col = (int64_t)num_cols * s / num_stripes;
+    const Position end_col = (int64_t)num_cols * (s + 1) / num_stripes;
+    SparseDp<Position> dp(k, lcsk_plus, &stripe_stats[s], match_pairs);
+    dp.set_stripe(begin_col, end_col);
+
+    for (int block_index = 0; block_index < num_blocks; ++block_index) {
+      WavefrontSlot<Position>& slot = slots[block_index % slots.size()];
+      Position row_end = numeric_limits<Position>::max();
+      {
+        unique_lock<mutex> lock(done_mutex);
+        block_done.wait(lock, [&] {
+          return block_index >= num_blocks_left ||
+                 (s > 0 ? done[s - 1] > block_index
+                        : done[num_stripes - 1] + (int)slots.size() >
+                              block_index);
+        });
+        if (block_index >= num_blocks_left) break;
+        row_end = stop_row;
+      }
+      if (s == 0) {
+        slot.matches = *pipeline->Next();
+      }
+
+      const MatchesBlock& block = slot.matches;
+      StripeBlock<Position>& out = slot.stripes[s];
+      out.rows.resize(block.row_end - block.row_begin);
+      out.passed.clear();
+      if (s > 0) {
+        for (const auto& event : slot.stripes[s - 1].passed) {
+          dp.Receive(event);
+        }
+      }
+      row_end = min<Position>(row_end, block.row_end);
+      for (Position row = block.row_begin; row < row_end; ++row) {
+        const int i = row - block.row_begin;
+        const uint32_t* cols_begin = block.cols.data() + block.offsets[i];
+        const uint32_t* cols_end = block.cols.data() + block.offsets[i + 1];
+        if (s == 0) {
+          if (budget->Expired(cols_end - cols_begin)) {
+            row_end = row;
+            break;
+          }
+          RecordRowMatches(cols_end - cols_begin, stats);
+        }
+        const uint32_t* first =
+            lower_bound(cols_begin, cols_end, (uint64_t)begin_col);
+        const uint32_t* last = lower_bound(first, cols_end, (uint64_t)end_col);
+        dp.ProcessRow(row, first, last);
+        if (s > 0) {
+          dp.SetLeft(slot.stripes[s - 1].rows[i]);
+        }
+        out.rows[i] = dp.Right();
+        auto* passed = dp.passed();
+        while (!passed->empty()) {
+          out.passed.push_back(passed->front());
+          passed->pop();
+        }
+      }
+
+      {
+        lock_guard<mutex> lock(done_mutex);
+        ++done[s];
+        if (s == 0 && budget->expired()) {
+          num_blocks_left = block_index + 1;
+          stop_row = row_end;
+        }
+      }
+      block_done.notify_all();
+    }
+    if (s == 0 && !budget->expired()) {
+      // Lets the pipeline know all of the blocks were consumed.
+      pipeline->Next();
+    }
+
+    table_sizes[s] = dp.table_size();
+    if (s == num_stripes - 1) {
+      // Its best entry is the best one of all of the stripes.
+      recon = dp.Reconstruction();
+    }
+  };
+
+  vector<thread> threads;
+  for (int s = 1; s < num_stripes; ++s) {
+    threads.emplace_back(process_stripe, s);
+  }
+  process_stripe(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // The pairs handed over are not needed anymore.
+  slots.clear();
+
+  for (int s = 0; s < num_stripes; ++s) {
+    stats->amortized_rows += stripe_stats[s].amortized_rows;
+    stats->elementwise_rows += stripe_stats[s].elementwise_rows;
+    stats->reconstruction_seconds += stripe_stats[s].reconstruction_seconds;
+  }
+  uint64_t table_size = 0;
+  for (int size : table_sizes) {
+    table_size += size;
+  }
+  stats->compressed_table_size =
+      max(stats->compressed_table_size, table_size);
+  stats->dp_seconds += stopwatch.Seconds() -
+      stripe_stats[num_stripes - 1].reconstruction_seconds;
+  // The producers may still be generating blocks if the budget expired.
+  pipeline->Stop();
+  stats->match_generation_seconds += pipeline->generation_seconds();
+  return recon;
+}
+
+template vector<LcskppRun> WavefrontLcskpp(int k, bool lcsk_plus,
+                                           int num_cols, int num_stripes,
+                                           MatchPipeline* pipeline,
+                                           CallBudget* budget,
+                                           LcskppStats* stats,
+                                           ObjectCounter* match_pairs);
+template vector<LcskppRun> WavefrontLcskpp(int k, bool lcsk_plus,
+                                           int64_t num_cols, int num_stripes,
+                                           MatchPipeline* pipeline,
+                                           CallBudget* budget,
+                                           LcskppStats* stats,
+                                           ObjectCounter* match_pairs);
@@ -0,0 +1,59 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef WAVEFRONT_DP
+#define WAVEFRONT_DP
+
+#include <cstdint>
+#include <vector>
+
+#include "call_budget.h"
+#include "lcsk.h"
+#include "lcsk_result.h"
+#include "match_pipeline.h"
+#include "../util/object_counter.h"
+
+// Number of stripes the wavefront dp should split num_cols columns into
+// when num_threads threads are available, 1 if it is not worth it. Half of
+// the threads are left to the match generation.
+int NumWavefrontStripes(int64_t num_cols, int k, int num_threads);
+
+// LCSk (or LCSk++) of the matches handed out by the pipeline, computed by
+// num_stripes threads. Gives reconstructions of the same length as a single
+// SparseDp over all of the columns.
+//
+// The num_cols columns of the match matrix are split into stripes, each of
+// them processed by its own SparseDp (see SparseDp::set_stripe) in its own
+// thread. A stripe processes a block of rows once the stripe on its left is
+// done with it, so the stripes move over the blocks as a wavefront, one
+// block apart. The stripe on the left hands over, for every row:
+//   - the best entry among the matches ending left of the stripe, which the
+//     matches of the stripe can all be chained to from the next row on,
+//   - the match ending in its last column, which the matches beginning in
+//     the next row can continue,
+//   - the matches beginning in it and ending in the stripe.
+// The budget is checked by the first stripe, once it expires the stripes
+// stop at the same row. Statistics of the call are added to stats,
+// dp_seconds is the wall time of the whole wavefront. Defined for Position
+// int and int64_t, see match_pair.h.
+template <typename Position>
+std::vector<LcskppRun> WavefrontLcskpp(int k, bool lcsk_plus,
+                                       Position num_cols, int num_stripes,
+                                       MatchPipeline* pipeline,
+                                       CallBudget* budget,
+                                       LcskppStats* stats,
+                                       ObjectCounter* match_pairs);
+
+#endif  // WAVEFRONT_DP
@@ -0,0 +1,95 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "util/sequence_generator.h"
+
+using namespace std;
+
+void print_usage_and_exit() {
+  printf(
+    "Generate a pair of synthetic sequences.\n\n"
+    "Usage: ./generate_sequences n output1 output2 [--seed SEED]\n"
+    "              [--alphabet ALPHABET] [--substitution RATE]\n"
+    "              [--insertion RATE] [--deletion RATE] [--indel-length MEAN]\n"
+    "              [--tandem-repeats COUNT] [--duplications COUNT]\n"
+    "output1 gets a random sequence of length n over ALPHABET (default ACTG)\n"
+    "and output2 its copy mutated with the given per character rates\n"
+    "(default 0). Indel lengths are geometric with mean MEAN (default 1).\n"
+    "--tandem-repeats adds COUNT tandem repeats (25 copies of a 20 character\n"
+    "unit) and --duplications COUNT segmental duplications (1000 characters,\n"
+    "5%% diverged) to the first sequence before it is copied.\n"
+    "The same SEED (default 1603) always gives the same sequences, which are\n"
+    "written as single lines, the input format of ./main.\n"
+  );
+  exit(0);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    print_usage_and_exit();
+  }
+
+  const long long n = atoll(argv[1]);
+  uint64_t seed = 1603;
+  string alphabet = "ACTG";
+  MutationRates rates;
+  int tandem_repeats = 0;
+  int duplications = 0;
+  for (int i = 4; i < argc; ++i) {
+    const string flag = argv[i];
+    if (i + 1 == argc) {
+      print_usage_and_exit();
+    }
+    const char* value = argv[++i];
+    if (flag == "--seed") {
+      seed = strtoull(value, nullptr, 10);
+    } else if (flag == "--alphabet") {
+      alphabet = value;
+    } else if (flag == "--substitution") {
+      rates.substitution = atof(value);
+    } else if (flag == "--insertion") {
+      rates.insertion = atof(value);
+    } else if (flag == "--deletion") {
+      rates.deletion = atof(value);
+    } else if (flag == "--indel-length") {
+      rates.mean_indel_length = atof(value);
+    } else if (flag == "--tandem-repeats") {
+      tandem_repeats = atoi(value);
+    } else if (flag == "--duplications") {
+      duplications = atoi(value);
+    } else {
+      print_usage_and_exit();
+    }
+  }
+  if (alphabet.empty()) {
+    print_usage_and_exit();
+  }
+
+  SequenceGenerator generator(seed, alphabet);
+  string a = generator.Random(n);
+  generator.AddSegmentalDuplications(&a, duplications, 1000, 0.05);
+  generator.AddTandemRepeats(&a, tandem_repeats, 20, 25);
+  const string b = generator.Mutate(a, rates);
+
+  ofstream output1(argv[2]);
+  output1 << a << '\n';
+  ofstream output2(argv[3]);
+  output2 << b << '\n';
+  return 0;
+}
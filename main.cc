@@ -12,28 +12,99 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cstdlib>
 #include <cassert>
 
 #include "fast_simple_lcsk/lcsk.h"
-#include "fast_simple_lcsk/match_pair.h"
+#include "fast_simple_lcsk/reference.h"
+#include "fast_simple_lcsk/result_cache.h"
+#include "fast_simple_lcsk/sketch.h"
+#include "server.h"
 
 using namespace std;
 
 const string kModeMa = "MA";
 const string kModeLcskpp = "LCSKPP";
 
+// Redirects the standard output to the output file.
+void open_output_or_exit(const char* path) {
+  if (freopen(path, "w", stdout) == nullptr) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    exit(1);
+  }
+}
+
 void print_usage_and_exit() {
   printf(
     "Compute LCSk++ of two plain texts.\n\n"
     "Usage: ./main k input1 input2 output [--reverse] [--mode MODE] [--runs RUNS]\n"
+    "              [--threads THREADS] [--stream] [--paf] [--engine ENGINE]\n"
+    "              [--band-width WIDTH] [--band-offset OFFSET]\n"
+    "              [--time-budget SECONDS] [--match-budget MATCHES]\n"
+    "              [--min-score SCORE] [--min-containment C] [--save-sketches]\n"
+    "              [--sweep K1,K2,...] [--profile WINDOW,STRIDE]\n"
+    "              [--row-sampling S] [--hash-sampling] [--cache DIR]\n"
+    "       ./main k --serve [--socket PATH] [--workers WORKERS]\n"
+    "              [--references REFERENCES] [--reverse] [--threads THREADS]\n"
+    "              [--time-budget SECONDS] [--match-budget MATCHES]\n"
     "If --reverse flag is used lcsk is run on both normal and reversed string"
     "Mode can be either LCSKPP (default), MS (multistart_2dlogarithmic) "
     "or MSA (multistart_aggressive)\n"
     "In MSA mode you can specify number of runs with --runs flag. In other modes "
-    "that flag is ignored."
+    "that flag is ignored.\n"
+    "--threads sets the number of threads used, 0 means one per core.\n"
+    "With --stream input1 is read in blocks instead of being loaded into "
+    "memory, - reads it from the standard input. Only LCSKPP mode is "
+    "supported then.\n"
+    "--engine forces the engine computing the dp, SPARSE, DENSE (only for "
+    "short strings in LCSKPP mode) or BANDED (only in LCSKPP mode), other "
+    "calls fail. By default it is chosen by the planner.\n"
+    "The BANDED engine only uses the matches of a[i] and b[j] with "
+    "|i - j - OFFSET| <= WIDTH. Unless --band-width is given the band is "
+    "estimated, setting it lets the planner choose the BANDED engine.\n"
+    "Once --time-budget seconds passed or the dp would process more than "
+    "--match-budget matches, the best chain found so far is written and "
+    "reported as partial.\n"
+    "With --min-score the dp stops as soon as LCSk++ is known to reach SCORE "
+    "or known not to, the best chain found so far is reported as partial.\n"
+    "With --min-containment LCSk++ is only computed if the estimated "
+    "fraction of the 16-mers of one input contained in the other one is at "
+    "least C, otherwise the output is empty. The estimate compares "
+    "FracMinHash sketches of the inputs, input.sketch files are used instead "
+    "of sketching the inputs when present, --save-sketches writes them. Not "
+    "supported with --stream.\n"
+    "With --sweep LCSk++ is computed for every one of the given ks in a "
+    "single pass, k is ignored and the output has a line with k and the "
+    "LCSk++ length per k. Not supported with --stream.\n"
+    "With --profile LCSk++ is computed for the windows of WINDOW characters "
+    "at the same positions of both inputs, every STRIDE characters, and the "
+    "output has a line with the start and the LCSk++ length per window. Not "
+    "supported with --stream.\n"
+    "With --row-sampling only the matches beginning in every S-th row of "
+    "input1 are used, or with --hash-sampling in about one in S rows chosen "
+    "by the hash of their k-mer. The output is a valid common subsequence, "
+    "its length a lower bound of LCSk++, which is estimated and bounded from "
+    "above too. Only in LCSKPP mode on the SPARSE engine, not with "
+    "--min-score or --stream.\n"
+    "With --cache results are stored in the directory DIR, named after a "
+    "hash of the inputs and the flags changing the result, and read from "
+    "there when the same inputs are compared again. Partial results are not "
+    "stored. Not supported with --stream, --sweep or --profile.\n"
+    "With --paf the output has a PAF line per run of consecutive matches, "
+    "instead of the common subsequence itself.\n"
+    "With --serve the process serves requests \"ID INPUT1 INPUT2\", one per "
+    "line, from the standard input or with --socket from the connections "
+    "to a Unix socket at PATH. Every request is answered by a line "
+    "\"ID LENGTH STATUS RUNS\" as soon as it is done, see server.h. "
+    "WORKERS requests (default one per core) are served at the same time, "
+    "each on a single thread, and the indexes of the last REFERENCES "
+    "(default 8) distinct INPUT2 files are kept. --threads is used for "
+    "building the indexes. A server on a socket stops on SIGINT or SIGTERM, "
+    "once the requests read so far are answered.\n"
     "Unlike most unix programs optional flags should be after mandatory args\n\n"
     "Example: ./main 4 test/tests/test.1.A test/tests/test.1.B out\n"
     "finds LCSK++ of files `test/tests/test.1.A` and `test/tests/test.1.B`\n"
@@ -43,25 +114,24 @@ void print_usage_and_exit() {
 }
 
 int main(int argc, char** argv) {
-  if (argc < 5) {
+  const bool serve = argc >= 3 && string(argv[2]) == "--serve";
+  if (argc < 5 && !serve) {
     print_usage_and_exit();
   };
 
   int k = stoi(argv[1]);
-  ifstream infile1(argv[2]);
-  string A;
-  getline(infile1, A);
-
-  ifstream infile2(argv[3]);
-  string B;
-  getline(infile2, B);
-
-  printf("Sequence 1 length: %d\n", (int)A.size());
-  printf("Sequence 2 length: %d\n", (int)B.size());
-
   LcskppParams params(k);
+  bool stream = false;
+  bool paf = false;
+  double min_containment = -1;
+  bool save_sketches = false;
+  vector<int> sweep_ks;
+  int profile_window = 0;
+  int profile_stride = 0;
+  string cache_directory;
+  LcskppServerOptions server_options;
   {
-    int i = 5;
+    int i = serve ? 3 : 5;
     while (i < argc) {
       if (string(argv[i]) == "--reverse") {
         params.reverse = true;
@@ -84,6 +154,105 @@ int main(int argc, char** argv) {
           print_usage_and_exit();
         }
         params.aggressive_runs = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--threads") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.num_threads = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--stream") {
+        stream = true;
+      } else if (string(argv[i]) == "--paf") {
+        paf = true;
+      } else if (string(argv[i]) == "--band-width") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.band_width = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--band-offset") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.band_offset = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--time-budget") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.time_budget_seconds = stod(argv[++i]);
+      } else if (string(argv[i]) == "--match-budget") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.match_budget = stoull(argv[++i]);
+      } else if (string(argv[i]) == "--min-score") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.min_score = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--min-containment") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        min_containment = stod(argv[++i]);
+      } else if (string(argv[i]) == "--save-sketches") {
+        save_sketches = true;
+      } else if (string(argv[i]) == "--sweep") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        stringstream ks(argv[++i]);
+        string sweep_k;
+        while (getline(ks, sweep_k, ',')) {
+          sweep_ks.push_back(stoi(sweep_k));
+        }
+      } else if (string(argv[i]) == "--row-sampling") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        params.row_sampling = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--hash-sampling") {
+        params.hash_row_sampling = true;
+      } else if (string(argv[i]) == "--profile") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        if (sscanf(argv[++i], "%d,%d", &profile_window, &profile_stride) != 2 ||
+            profile_window <= 0 || profile_stride <= 0) {
+          print_usage_and_exit();
+        }
+      } else if (string(argv[i]) == "--cache") {
+        if (i + 1 >= argc) {
+          print_usage_and_exit();
+        }
+        cache_directory = argv[++i];
+      } else if (serve && string(argv[i]) == "--socket") {
+        if (i + 1 >= argc) {
+          print_usage_and_exit();
+        }
+        server_options.socket_path = argv[++i];
+      } else if (serve && string(argv[i]) == "--workers") {
+        if (i + 1 >= argc) {
+          print_usage_and_exit();
+        }
+        server_options.num_workers = stoi(argv[++i]);
+      } else if (serve && string(argv[i]) == "--references") {
+        if (i + 1 >= argc) {
+          print_usage_and_exit();
+        }
+        server_options.max_references = stoi(argv[++i]);
+      } else if (string(argv[i]) == "--engine") {
+        if (i + 1 == argc) {
+          print_usage_and_exit();
+        }
+        string engine = argv[++i];
+        if (engine == "SPARSE") {
+          params.engine = LcskppParams::Engine::SPARSE;
+        } else if (engine == "DENSE") {
+          params.engine = LcskppParams::Engine::DENSE;
+        } else if (engine == "BANDED") {
+          params.engine = LcskppParams::Engine::BANDED;
+        } else {
+          print_usage_and_exit();
+        }
       } else {
         print_usage_and_exit();
       }
@@ -91,21 +260,225 @@ int main(int argc, char** argv) {
     }
   }
 
-  printf("Computing LCSk++..\n");
-  auto recon = LcskppSparseFast(A, B, params);
-  int length = recon.size();
+  if (serve) {
+    // Requests run on the indexed references, as streamed calls do.
+    if (params.mode != LcskppParams::Mode::SINGLESTART || stream || paf ||
+        params.engine != LcskppParams::Engine::AUTO ||
+        params.band_width >= 0 || params.min_score > 0 ||
+        min_containment >= 0 || !sweep_ks.empty() || profile_window > 0 ||
+        params.row_sampling > 1 || !cache_directory.empty()) {
+      print_usage_and_exit();
+    }
+    server_options.params = params;
+    return RunLcskppServer(server_options);
+  }
+  if (!cache_directory.empty() &&
+      (stream || !sweep_ks.empty() || profile_window > 0)) {
+    print_usage_and_exit();
+  }
+  if (stream && (params.mode != LcskppParams::Mode::SINGLESTART ||
+                 min_containment >= 0 || !sweep_ks.empty() ||
+                 profile_window > 0 || params.row_sampling > 1)) {
+    print_usage_and_exit();
+  }
+  if (params.row_sampling > 1 &&
+      (params.mode != LcskppParams::Mode::SINGLESTART ||
+       params.min_score > 0 ||
+       (params.engine != LcskppParams::Engine::AUTO &&
+        params.engine != LcskppParams::Engine::SPARSE))) {
+    print_usage_and_exit();
+  }
+
+  ifstream infile2(argv[3]);
+  string B;
+  getline(infile2, B);
+
+  string A;
+  LcskppResult recon;
+  LcskppStats stats;
+  long long a_length = 0;
+  if (stream) {
+    printf("Sequence 2 length: %d\n", (int)B.size());
+    LcskppReference reference(B, params);
 
-  printf("LCSk++ length: %d\n", length);
-  cout << "MatchPairs created: " << ObjectCounter<MatchPair>::objects_created << endl;
-  cout << "Max Alive MatchPairs: " << ObjectCounter<MatchPair>::max_objects_alive << endl;
+    // The first line of input1 is read in blocks.
+    ifstream infile1;
+    istream& input1 = string(argv[2]) == "-" ? cin : infile1;
+    if (&input1 == &infile1) infile1.open(argv[2]);
+    bool end_of_line = false;
+    auto read_line = [&](char* buffer, size_t size) -> size_t {
+      if (end_of_line) return 0;
+      input1.read(buffer, size);
+      size_t read = input1.gcount();
+      char* newline = find(buffer, buffer + read, '\n');
+      end_of_line = newline != buffer + read;
+      a_length += newline - buffer;
+      return newline - buffer;
+    };
+
+    printf("Computing LCSk++..\n");
+    recon = LcskppSparseFastStream(read_line, reference, params, &stats);
+    if (recon.invalid_params) {
+      fprintf(stderr, "Streamed calls only support LCSKPP mode\n");
+      return 1;
+    }
+    // A call which ran out of its budget stops reading a early, the rest of
+    // it is only counted.
+    vector<char> rest(1 << 16);
+    while (read_line(rest.data(), rest.size()) > 0) {
+    }
+  } else {
+    ifstream infile1(argv[2]);
+    getline(infile1, A);
+
+    printf("Sequence 1 length: %d\n", (int)A.size());
+    printf("Sequence 2 length: %d\n", (int)B.size());
+
+    if (min_containment >= 0) {
+      // Sketches of the inputs are reused if they were built with the same
+      // params.
+      const SketchParams sketch_params;
+      auto sketch = [&](const string& s, const string& path) {
+        Sketch sketch;
+        if (!LoadSketch(SketchPath(path), &sketch) ||
+            sketch.params() != sketch_params) {
+          sketch = Sketch(s, sketch_params);
+          if (save_sketches && !SaveSketch(sketch, SketchPath(path))) {
+            fprintf(stderr, "Cannot write %s\n", SketchPath(path).c_str());
+          }
+        }
+        return sketch;
+      };
+      const Sketch sketch_a = sketch(A, argv[2]);
+      const Sketch sketch_b = sketch(B, argv[3]);
+      const double containment = max(sketch_a.Containment(sketch_b),
+                                     sketch_b.Containment(sketch_a));
+      printf("Estimated containment: %.3f\n", containment);
+      if (containment < min_containment) {
+        printf("Below the cutoff, LCSk++ not computed\n");
+        // The output is left empty.
+        open_output_or_exit(argv[4]);
+        return 0;
+      }
+    }
+
+    if (!sweep_ks.empty()) {
+      printf("Computing LCSk++ for %d ks..\n", (int)sweep_ks.size());
+      const auto results = LcskppSparseFastSweep(A, B, sweep_ks, params,
+                                                 &stats);
+      printf("Time (s): alphabet %.3f, index %.3f, matches %.3f, dp %.3f, "
+             "reconstruction %.3f\n",
+             stats.alphabet_seconds, stats.index_seconds,
+             stats.match_generation_seconds, stats.dp_seconds,
+             stats.reconstruction_seconds);
+      open_output_or_exit(argv[4]);
+      for (size_t i = 0; i < sweep_ks.size(); ++i) {
+        printf("%d %d%s\n", sweep_ks[i], (int)results[i].size(),
+               results[i].partial ? " partial" : "");
+      }
+      return 0;
+    }
+
+    if (profile_window > 0) {
+      printf("Computing LCSk++ profile..\n");
+      const LcskppProfile profile = LcskppSparseFastProfile(
+          A, B, profile_window, profile_stride, params, &stats);
+      printf("Time (s): alphabet %.3f, index %.3f, matches %.3f, dp %.3f, "
+             "reconstruction %.3f\n",
+             stats.alphabet_seconds, stats.index_seconds,
+             stats.match_generation_seconds, stats.dp_seconds,
+             stats.reconstruction_seconds);
+      if (profile.partial) {
+        printf("Partial result, the budget expired\n");
+      }
+      open_output_or_exit(argv[4]);
+      for (size_t i = 0; i < profile.scores.size(); ++i) {
+        printf("%lld %d\n", (long long)i * profile_stride, profile.scores[i]);
+      }
+      return 0;
+    }
+
+    printf("Computing LCSk++..\n");
+    if (cache_directory.empty()) {
+      recon = LcskppSparseFastRuns(A, B, params, &stats);
+    } else {
+      // Only the directory is used, a single result is not kept in memory.
+      LcskppResultCache cache(0, cache_directory);
+      recon = cache.Runs(A, B, params, &stats);
+      printf("Cache: %s\n", cache.counters().misses ? "miss" : "hit");
+    }
+    if (recon.invalid_params) {
+      fprintf(stderr, "The engine is not able to run these params\n");
+      return 1;
+    }
+  }
+  long long length = recon.size();
+  // The length of a streamed a is known once it was read.
+  if (!stream) a_length = A.size();
+
+  printf("LCSk++ length: %lld\n", length);
+  if (recon.partial) {
+    printf("Partial result, the budget expired or the min score decided\n");
+  }
+  if (params.row_sampling > 1) {
+    printf("Sampled rows, estimated LCSk++ length %.0f, at most %lld\n",
+           recon.estimated_size, (long long)recon.upper_bound);
+  }
+  const char* engine = "sparse";
+  if (stats.engine == LcskppParams::Engine::DENSE) {
+    engine = "dense";
+  } else if (stats.engine == LcskppParams::Engine::BANDED) {
+    engine = "banded";
+  }
+  printf("Engine: %s, estimated matches %llu, predicted %.3f s and %llu "
+         "bytes\n",
+         engine, (unsigned long long)stats.estimated_matches,
+         stats.predicted_seconds, (unsigned long long)stats.predicted_bytes);
+  if (stats.engine == LcskppParams::Engine::BANDED) {
+    printf("Band: offset %d, width %d\n", stats.band_offset,
+           stats.band_width);
+  }
+  cout << "MatchPairs created: " << stats.match_pairs_created << endl;
+  cout << "Max Alive MatchPairs: " << stats.max_live_match_pairs << endl;
+  cout << "Matches: " << stats.num_matches << endl;
+  cout << "Compressed table size: " << stats.compressed_table_size << endl;
+  cout << "Amortized/elementwise rows: " << stats.amortized_rows << "/"
+       << stats.elementwise_rows << endl;
+  printf("Time (s): plan %.3f, alphabet %.3f, index %.3f, matches %.3f, "
+         "dp %.3f, reconstruction %.3f, merge %.3f\n",
+         stats.plan_seconds, stats.alphabet_seconds, stats.index_seconds,
+         stats.match_generation_seconds, stats.dp_seconds,
+         stats.reconstruction_seconds, stats.merge_seconds);
+
+  open_output_or_exit(argv[4]);
+  if (paf) {
+    // Every run is an ungapped alignment: query a, target b, run.length
+    // matches out of run.length columns. Runs found against reversed b are
+    // on the - strand.
+    for (const auto& run : recon.runs) {
+      const long long a_begin = run.a_start;
+      const long long b_begin =
+          run.reverse ? run.b_start - run.length + 1 : run.b_start;
+      const long long length = run.length;
+      printf("a\t%lld\t%lld\t%lld\t%c\tb\t%lld\t%lld\t%lld\t%lld\t%lld\t255"
+             "\tcg:Z:%lldM\n",
+             a_length, a_begin, a_begin + length, run.reverse ? '-' : '+',
+             (long long)B.size(), b_begin, b_begin + length, length, length,
+             length);
+    }
+    return 0;
+  }
 
-  auto r = freopen(argv[4], "w", stdout);
-  int last_position = -1;
+  string output;
+  output.reserve(length);
+  int64_t last_position = -1;
   for (auto& p: recon) {
     if (last_position != p.first) {
-      putchar(A[p.first]);
+      // a[p.first] == b[p.second], so b is used when a was not kept.
+      output.push_back(B[p.second]);
       last_position = p.first;
     }
   }
+  fwrite(output.data(), 1, output.size(), stdout);
   return 0;
 }
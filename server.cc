@@ -0,0 +1,436 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "server.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "util/parallel.h"
+#include "util/stopwatch.h"
+
+using namespace std;
+
+namespace {
+
+// Where the answers to the requests of a connection (or of the standard
+// input) go. Shared by the requests, it is closed once all of them are
+// answered.
+class Connection {
+ public:
+  Connection(int fd, bool owned) : fd_(fd), owned_(owned) {}
+  ~Connection() {
+    if (owned_) close(fd_);
+  }
+
+  // Lines of different requests are not interleaved. Write errors are
+  // ignored, the client may have gone away.
+  void WriteLine(string line) {
+    line.push_back('\n');
+    lock_guard<mutex> lock(mutex_);
+    for (size_t written = 0; written < line.size();) {
+      const ssize_t count =
+          write(fd_, line.data() + written, line.size() - written);
+      if (count < 0 && errno == EINTR) continue;
+      if (count <= 0) return;
+      written += count;
+    }
+  }
+
+  // Makes the pending and the following reads of the requests end, the
+  // answers can still be written.
+  void StopReading() { shutdown(fd_, SHUT_RD); }
+
+ private:
+  const int fd_;
+  const bool owned_;
+  mutex mutex_;
+};
+
+struct Request {
+  string line;
+  shared_ptr<Connection> connection;
+};
+
+// Requests queued per worker.
+const int kQueuedRequestsPerWorker = 4;
+
+// Write end of the pipe the signals stopping the server are passed through.
+int stop_pipe_fd = -1;
+
+void RequestStop(int) {
+  const char byte = 0;
+  // Nothing can be done about a failed write in a signal handler.
+  if (write(stop_pipe_fd, &byte, 1) < 0) return;
+}
+
+// Requests waiting for a worker. Pushing to a full queue waits until a
+// worker takes a request, so a connection is not read further while the
+// workers are behind and its client is held back.
+class RequestQueue {
+ public:
+  explicit RequestQueue(size_t capacity) : capacity_(capacity),
+                                           closed_(false) {}
+
+  // False if the queue was closed, the request is dropped then.
+  bool Push(Request request) {
+    {
+      unique_lock<mutex> lock(mutex_);
+      not_full_.wait(lock, [&] {
+        return closed_ || requests_.size() < capacity_;
+      });
+      if (closed_) return false;
+      requests_.push_back(move(request));
+    }
+    ready_.notify_one();
+    return true;
+  }
+
+  // Waits for a request, false once the queue is closed and empty.
+  bool Pop(Request* request) {
+    {
+      unique_lock<mutex> lock(mutex_);
+      ready_.wait(lock, [&] { return closed_ || !requests_.empty(); });
+      if (requests_.empty()) return false;
+      *request = move(requests_.front());
+      requests_.pop_front();
+    }
+    not_full_.notify_one();
+    return true;
+  }
+
+  // The queued requests are still popped.
+  void Close() {
+    {
+      lock_guard<mutex> lock(mutex_);
+      closed_ = true;
+    }
+    ready_.notify_all();
+    not_full_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  mutex mutex_;
+  condition_variable ready_;
+  condition_variable not_full_;
+  deque<Request> requests_;
+  bool closed_;
+};
+
+void Serve(const Request& request, const LcskppParams& params,
+           ReferenceCache* references) {
+  const string answer = ServeRequest(request.line, params, references);
+  if (!answer.empty()) request.connection->WriteLine(answer);
+}
+
+// Queues the requests of a connection until it ends.
+void ReadRequests(int fd, shared_ptr<Connection> connection,
+                  RequestQueue* queue) {
+  LineReader reader(fd);
+  string line;
+  while (reader.Next(&line) && queue->Push({line, connection})) {
+  }
+}
+
+int Listen(const string& path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path.c_str());
+    return -1;
+  }
+  strcpy(address.sun_path, path.c_str());
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("socket");
+    return -1;
+  }
+  // A socket left behind by a previous server is replaced.
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    perror(path.c_str());
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// A connection of the socket, read by a thread of its own.
+struct ConnectionReader {
+  // The connection is closed once its requests are read and answered, the
+  // reader does not keep it open.
+  weak_ptr<Connection> connection;
+  thread reader;
+  atomic<bool> done{false};
+};
+
+}  // namespace
+
+bool LineReader::Next(string* line) {
+  while (true) {
+    const size_t newline = buffer_.find('\n', begin_);
+    if (newline != string::npos) {
+      line->assign(buffer_, begin_, newline - begin_);
+      begin_ = newline + 1;
+      return true;
+    }
+    buffer_.erase(0, begin_);
+    begin_ = 0;
+    char block[1 << 16];
+    const ssize_t count = read(fd_, block, sizeof(block));
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) {
+      if (buffer_.empty()) return false;
+      line->swap(buffer_);
+      buffer_.clear();
+      return true;
+    }
+    buffer_.append(block, count);
+  }
+}
+
+shared_ptr<const LcskppReference> ReferenceCache::Get(const string& path) {
+  promise<shared_ptr<const LcskppReference>> loaded;
+  {
+    unique_lock<mutex> lock(mutex_);
+    for (auto it = references_.begin(); it != references_.end(); ++it) {
+      if (it->first == path) {
+        references_.splice(references_.begin(), references_, it);
+        return it->second;
+      }
+    }
+    auto loading = loading_.find(path);
+    if (loading != loading_.end()) {
+      shared_future<shared_ptr<const LcskppReference>> reference =
+          loading->second;
+      lock.unlock();
+      return reference.get();
+    }
+    loading_.emplace(path, loaded.get_future().share());
+  }
+
+  shared_ptr<const LcskppReference> reference;
+  try {
+    ifstream file(path);
+    string b;
+    if (file && getline(file, b)) {
+      reference = make_shared<const LcskppReference>(b, params_);
+    }
+  } catch (...) {
+    lock_guard<mutex> lock(mutex_);
+    loading_.erase(path);
+    loaded.set_exception(current_exception());
+    throw;
+  }
+  lock_guard<mutex> lock(mutex_);
+  loading_.erase(path);
+  loaded.set_value(reference);
+  if (reference == nullptr) return nullptr;
+  references_.emplace_front(path, reference);
+  while ((int)references_.size() > max(1, max_references_)) {
+    references_.pop_back();
+  }
+  return reference;
+}
+
+string FormatResult(const string& id, const LcskppResult& result) {
+  ostringstream out;
+  out << id << '\t' << result.size() << '\t'
+      << (result.partial ? "partial" : "complete") << '\t';
+  for (size_t i = 0; i < result.runs.size(); ++i) {
+    const LcskppRun& run = result.runs[i];
+    if (i > 0) out << ' ';
+    out << run.a_start << ',' << run.b_start << ',' << run.length << ','
+        << (run.reverse ? '-' : '+');
+  }
+  return out.str();
+}
+
+string ServeRequest(const string& line, const LcskppParams& params,
+                    ReferenceCache* references) {
+  istringstream fields(line);
+  string id, a_path, b_path, extra;
+  if (!(fields >> id)) return "";
+  if (!(fields >> a_path >> b_path) || (fields >> extra)) {
+    return id + "\terror\texpected ID A_PATH B_PATH";
+  }
+  ifstream a_file(a_path);
+  string a;
+  if (!a_file || !getline(a_file, a)) {
+    return id + "\terror\tcannot read " + a_path;
+  }
+  const auto reference = references->Get(b_path);
+  if (reference == nullptr) {
+    return id + "\terror\tcannot read " + b_path;
+  }
+  // a is in memory, its length lets the call use 32-bit positions (0 would
+  // mean no bound).
+  LcskppParams a_params = params;
+  a_params.max_a_length = max<size_t>(a.size(), 1);
+  istringstream a_stream(a);
+  return FormatResult(id, LcskppSparseFastStream(a_stream, *reference,
+                                                 a_params));
+}
+
+int RunLcskppServer(const LcskppServerOptions& options) {
+  if (options.params.mode != LcskppParams::Mode::SINGLESTART) {
+    fprintf(stderr, "The server only supports SINGLESTART mode\n");
+    return 1;
+  }
+  // Clients closing their connection early must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+
+  LcskppParams params = options.params;
+  params.num_threads = 1;
+  ReferenceCache references(options.params, options.max_references);
+  const int num_workers = ResolveNumThreads(options.num_workers);
+  RequestQueue queue(kQueuedRequestsPerWorker * num_workers);
+  vector<thread> workers;
+  for (int i = 0; i < num_workers; ++i) {
+    workers.emplace_back([&] {
+      Request request;
+      while (queue.Pop(&request)) {
+        Serve(request, params, &references);
+        // The connection is closed once its last request is answered.
+        request = Request();
+      }
+    });
+  }
+  // Answers the queued requests and stops the workers.
+  auto finish = [&] {
+    queue.Close();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  };
+
+  if (options.socket_path.empty()) {
+    Stopwatch stopwatch;
+    ReadRequests(STDIN_FILENO, make_shared<Connection>(STDOUT_FILENO, false),
+                 &queue);
+    finish();
+    fprintf(stderr, "Served in %.3f s\n", stopwatch.Seconds());
+    return 0;
+  }
+
+  // The signals stopping the server and the readers of the connections
+  // which are read to the end wake the loop through pipes.
+  int stop_pipe[2];
+  int done_pipe[2];
+  if (pipe(stop_pipe) < 0) {
+    perror("pipe");
+    finish();
+    return 1;
+  }
+  if (pipe(done_pipe) < 0) {
+    perror("pipe");
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    finish();
+    return 1;
+  }
+  const int listen_fd = Listen(options.socket_path);
+  if (listen_fd < 0) {
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    close(done_pipe[0]);
+    close(done_pipe[1]);
+    finish();
+    return 1;
+  }
+  stop_pipe_fd = stop_pipe[1];
+  signal(SIGINT, RequestStop);
+  signal(SIGTERM, RequestStop);
+  fprintf(stderr, "Listening on %s\n", options.socket_path.c_str());
+  list<unique_ptr<ConnectionReader>> readers;
+  pollfd fds[3] = {{listen_fd, POLLIN, 0}, {stop_pipe[0], POLLIN, 0},
+                   {done_pipe[0], POLLIN, 0}};
+  while (true) {
+    // Threads of the connections which were read to the end are joined.
+    for (auto it = readers.begin(); it != readers.end();) {
+      if ((*it)->done) {
+        (*it)->reader.join();
+        it = readers.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (poll(fds, 3, -1) < 0) {
+      if (errno != EINTR) perror("poll");
+      continue;
+    }
+    if (fds[1].revents != 0) break;
+    if (fds[2].revents != 0) {
+      char bytes[64];
+      if (read(done_pipe[0], bytes, sizeof(bytes)) < 0) perror("read");
+      continue;
+    }
+    if ((fds[0].revents & POLLIN) == 0) continue;
+    const int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno != EINTR) perror("accept");
+      continue;
+    }
+    // Every connection gets a thread reading its requests, the answers are
+    // written by the workers.
+    auto connection = make_shared<Connection>(fd, true);
+    readers.emplace_back(new ConnectionReader);
+    ConnectionReader* reader = readers.back().get();
+    reader->connection = connection;
+    const int done_fd = done_pipe[1];
+    reader->reader = thread([reader, fd, connection, done_fd, &queue] {
+      ReadRequests(fd, connection, &queue);
+      reader->done = true;
+      const char byte = 0;
+      if (write(done_fd, &byte, 1) < 0) perror("write");
+    });
+  }
+
+  fprintf(stderr, "Stopping\n");
+  close(listen_fd);
+  unlink(options.socket_path.c_str());
+  for (auto& reader : readers) {
+    if (auto connection = reader->connection.lock()) {
+      connection->StopReading();
+    }
+  }
+  for (auto& reader : readers) {
+    reader->reader.join();
+  }
+  finish();
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  close(stop_pipe[0]);
+  close(stop_pipe[1]);
+  close(done_pipe[0]);
+  close(done_pipe[1]);
+  return 0;
+}
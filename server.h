@@ -0,0 +1,110 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SERVER
+#define SERVER
+
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "fast_simple_lcsk/lcsk.h"
+#include "fast_simple_lcsk/reference.h"
+
+// Server mode of main: a process which serves many LCSk++ requests, so that
+// neither the process startup nor the index of a frequently used b is paid
+// per pair.
+//
+// A request is a line "ID A_PATH B_PATH", the fields separated by
+// whitespace. As for a single pair, the strings are the first lines of the
+// files. Requests are answered as they are done, not in order, by a line
+// "ID LENGTH STATUS RUNS" separated by tabs: STATUS is complete or partial
+// and RUNS lists the runs of consecutive matches as space separated
+// "A_START,B_START,LENGTH,STRAND", the strand being - for the runs against
+// reversed b (see LcskppRun). A request which can not be served is answered
+// by "ID error MESSAGE".
+struct LcskppServerOptions {
+  // Params of every request, it has to be in SINGLESTART mode. The indexes
+  // of b are built using params.num_threads threads, while a request runs on
+  // a single one, several requests run at the same time instead.
+  LcskppParams params;
+  // Number of requests served at the same time, 0 means one per core.
+  int num_workers = 0;
+  // Number of indexed bs kept, the least recently used ones are dropped.
+  int max_references = 8;
+  // If empty requests are read from the standard input and answered on the
+  // standard output until the input ends, a manifest can be piped in.
+  // Otherwise the server listens on a Unix socket at the path, every
+  // connection sends its requests and gets their answers. On SIGINT or
+  // SIGTERM it stops reading requests, answers the ones already read and
+  // removes the socket.
+  std::string socket_path;
+};
+
+// Returns the exit code of the process.
+int RunLcskppServer(const LcskppServerOptions& options);
+
+// Building blocks of the server.
+
+// Splits what is read from a file descriptor into lines.
+class LineReader {
+ public:
+  explicit LineReader(int fd) : fd_(fd), begin_(0) {}
+
+  // False once the input ended. A last line without a newline is returned
+  // too.
+  bool Next(std::string* line);
+
+ private:
+  const int fd_;
+  std::string buffer_;
+  size_t begin_;
+};
+
+// Indexed bs by the path of their file, the most recently used first.
+// References in use stay alive when they are dropped. A b is indexed once,
+// requests for it which come in meanwhile wait for its index.
+class ReferenceCache {
+ public:
+  ReferenceCache(const LcskppParams& params, int max_references)
+      : params_(params), max_references_(max_references) {}
+
+  // Null if the file can not be read.
+  std::shared_ptr<const LcskppReference> Get(const std::string& path);
+
+ private:
+  const LcskppParams params_;
+  const int max_references_;
+  std::mutex mutex_;
+  std::list<std::pair<std::string, std::shared_ptr<const LcskppReference>>>
+      references_;
+  // Paths of the bs being indexed.
+  std::map<std::string,
+           std::shared_future<std::shared_ptr<const LcskppReference>>>
+      loading_;
+};
+
+// Answer line of a request with the given id, without the newline.
+std::string FormatResult(const std::string& id, const LcskppResult& result);
+
+// Answer line of the request line, empty for an empty request (which is
+// not answered).
+std::string ServeRequest(const std::string& line, const LcskppParams& params,
+                         ReferenceCache* references);
+
+#endif  // SERVER
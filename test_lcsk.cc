@@ -12,23 +12,40 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <unistd.h>
+
 #include <cassert>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <cmath>
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <functional>
 
+#include "fast_simple_lcsk/dense_dp.h"
+#include "fast_simple_lcsk/kmer_index.h"
 #include "fast_simple_lcsk/lcsk.h"
+#include "fast_simple_lcsk/lcsk_c.h"
+#include "fast_simple_lcsk/match_maker.h"
+#include "fast_simple_lcsk/match_pair.h"
+#include "fast_simple_lcsk/reference.h"
+#include "fast_simple_lcsk/result_cache.h"
+#include "fast_simple_lcsk/rolling_hasher.h"
+#include "fast_simple_lcsk/sketch.h"
+#include "server.h"
 #include "util/lcsk_testing.h"
 #include "util/random_strings.h"
+#include "util/sequence_generator.h"
 using namespace std;
 
 const int only_run_fast_version = 0;
@@ -156,6 +173,242 @@ void LcskppTest() {
   printf("Test PASSED!\n");
 }
 
+void LcskppIndelTest() {
+  printf("LcskppIndelTest\n");
+  SequenceGenerator generator(1603);
+  MutationRates rates;
+  rates.substitution = 0.05;
+  rates.insertion = 0.03;
+  rates.deletion = 0.03;
+  rates.mean_indel_length = 2;
+  for (int i = 0; i < 1000; ++i) {
+    const string a = generator.Random(kStringLen);
+    const string b = generator.Mutate(a, rates);
+    test_lcsk(a, b, LcskppParams(kK),
+              [](const string &a, const string &b) {
+                return LcskppSparseSlow(a, b, kK);
+              },
+              [](const string &a, const string &b,
+                 const vector<pair<int, int>> &recon) {
+                return ValidLcskpp(a, b, kK, recon);
+              });
+  }
+  printf("Test PASSED!\n");
+}
+
+void DenseLcskppTest() {
+  printf("DenseLcskppTest\n");
+  SequenceGenerator generator(1603);
+  MutationRates rates;
+  rates.substitution = 0.1;
+  rates.insertion = 0.02;
+  rates.deletion = 0.02;
+  for (int i = 0; i < 2000; ++i) {
+    // Lengths cross the word boundaries of the bit vectors.
+    const string a = generator.Random(rand() % 150);
+    const string b = i % 4 ? generator.Mutate(a, rates)
+                           : generator.Random(rand() % 150);
+    const int k = 1 + rand() % 6;
+    for (bool lcsk_plus : {false, true}) {
+      LcskppParams params(k);
+      params.lcsk_plus = lcsk_plus;
+      params.engine = LcskppParams::Engine::DENSE;
+      auto recon = LcskppSparseFast(a, b, params);
+      int expected_length;
+      if (lcsk_plus) {
+        LcskppSlow(a, b, k, &expected_length);
+        assert(ValidLcskpp(a, b, k, recon));
+      } else {
+        LcskSlow(a, b, k, &expected_length);
+        assert(ValidLcsk(a, b, k, recon));
+      }
+      assert(recon.size() == expected_length);
+
+      params.engine = LcskppParams::Engine::SPARSE;
+      params.reverse = true;
+      const int sparse_size = LcskppSparseFast(a, b, params).size();
+      params.engine = LcskppParams::Engine::DENSE;
+      assert(LcskppSparseFast(a, b, params).size() == sparse_size);
+    }
+  }
+
+  // Short inputs go to the dense engine on their own.
+  const string a = generator.Random(300);
+  assert(FitsDense(a, a));
+  LcskppStats stats;
+  assert(LcskppSparseFast(a, a, LcskppParams(kK), &stats).size() == a.size());
+  assert(stats.match_pairs_created == 0);
+  assert(stats.num_matches > 0);
+  printf("Test PASSED!\n");
+}
+
+void DenseSparseTest() {
+  printf("DenseSparseTest\n");
+  SequenceGenerator generator(1603);
+  MutationRates rates;
+  rates.substitution = 0.1;
+  rates.insertion = 0.02;
+  rates.deletion = 0.02;
+  for (int i = 0; i < 1000; ++i) {
+    const string a = generator.Random(rand() % 300);
+    const string b = i % 4 ? generator.Mutate(a, rates)
+                           : generator.Random(rand() % 300);
+    for (bool lcsk_plus : {false, true}) {
+      LcskppParams params(1 + rand() % 6);
+      params.lcsk_plus = lcsk_plus;
+      params.reverse = i % 2;
+      params.engine = LcskppParams::Engine::SPARSE;
+      const auto expected = LcskppSparseFastRuns(a, b, params).runs;
+      // The dense engine walks back the same chain.
+      params.engine = LcskppParams::Engine::DENSE;
+      assert(LcskppSparseFastRuns(a, b, params).runs == expected);
+    }
+  }
+
+  // Strings which do not fit the dense tables can not be forced on it.
+  const string a = generator.Random(1000);
+  const string b = generator.Mutate(a, rates);
+  assert(!FitsDense(a, b));
+  LcskppParams params(kK);
+  params.engine = LcskppParams::Engine::DENSE;
+  assert(!LcskppParamsValid(a, b, params));
+  const LcskppResult result = LcskppSparseFastRuns(a, b, params);
+  assert(result.invalid_params && result.runs.empty());
+  printf("Test PASSED!\n");
+}
+
+void PlannerTest() {
+  printf("PlannerTest\n");
+  SequenceGenerator generator(1603);
+  MutationRates rates;
+  rates.substitution = 0.05;
+  const string a = generator.Random(20000);
+  const string b = generator.Mutate(a, rates);
+  LcskppStats stats;
+  LcskppSparseFast(a, b, LcskppParams(8), &stats);
+  assert(stats.engine == LcskppParams::Engine::SPARSE);
+  assert(stats.estimated_matches > 0.9 * stats.num_matches &&
+         stats.estimated_matches < 1.1 * stats.num_matches);
+  assert(stats.predicted_seconds > 0 && stats.predicted_bytes > 0);
+
+  // Short reads with many matches are cheaper on the dense engine.
+  const string read = generator.Random(150);
+  const string mutated_read = generator.Mutate(read, rates);
+  LcskppParams params(4);
+  LcskppSparseFast(read, mutated_read, params, &stats);
+  assert(stats.engine == LcskppParams::Engine::DENSE);
+  assert(stats.match_pairs_created == 0);
+
+  // Forced engines give the same length.
+  params.engine = LcskppParams::Engine::SPARSE;
+  const int length = LcskppSparseFast(read, mutated_read, params).size();
+  LcskppSparseFast(read, mutated_read, params, &stats);
+  assert(stats.engine == LcskppParams::Engine::SPARSE);
+  params.engine = LcskppParams::Engine::DENSE;
+  assert(LcskppSparseFast(read, mutated_read, params).size() == length);
+
+  // Only the sparse engine runs multistart modes, forcing another one is
+  // invalid.
+  params.engine = LcskppParams::Engine::AUTO;
+  params.mode = LcskppParams::Mode::MULTISTART_AGGRESSIVE;
+  LcskppSparseFast(read, mutated_read, params, &stats);
+  assert(stats.engine == LcskppParams::Engine::SPARSE);
+  params.engine = LcskppParams::Engine::BANDED;
+  assert(!LcskppParamsValid(read, mutated_read, params));
+  assert(LcskppSparseFastRuns(read, mutated_read, params).invalid_params);
+  printf("Test PASSED!\n");
+}
+
+void BandedTest() {
+  printf("BandedTest\n");
+  SequenceGenerator generator(1603);
+  MutationRates rates;
+  rates.substitution = 0.05;
+  rates.insertion = 0.005;
+  rates.deletion = 0.005;
+  rates.mean_indel_length = 2;
+  for (bool lcsk_plus : {false, true}) {
+    // A band covering the whole matrix changes nothing.
+    const string a = generator.Random(2000);
+    const string b = generator.Mutate(a, rates);
+    LcskppParams params(kK);
+    params.lcsk_plus = lcsk_plus;
+    params.engine = LcskppParams::Engine::SPARSE;
+    const auto expected = LcskppSparseFastRuns(a, b, params).runs;
+    params.engine = LcskppParams::Engine::BANDED;
+    params.band_width = 4000;
+    assert(LcskppSparseFastRuns(a, b, params).runs == expected);
+
+    // b starts with 500 unrelated characters, the band is found around
+    // them and the table is pruned to it.
+    const string long_a = generator.Random(100000);
+    const string long_b =
+        generator.Random(500) + generator.Mutate(long_a, rates);
+    params.k = 10;
+    params.engine = LcskppParams::Engine::SPARSE;
+    params.band_width = -1;
+    LcskppStats stats;
+    const int length = LcskppSparseFast(long_a, long_b, params, &stats).size();
+    const uint64_t num_matches = stats.num_matches;
+    params.engine = LcskppParams::Engine::BANDED;
+    auto recon = LcskppSparseFast(long_a, long_b, params, &stats);
+    assert(recon.size() == length);
+    assert(abs(stats.band_offset + 500) < 50 && stats.band_width < 200);
+    for (const auto &match : recon) {
+      assert(abs(match.first - match.second - stats.band_offset) <=
+             stats.band_width);
+    }
+    assert(stats.num_matches < num_matches);
+    assert(stats.compressed_table_size < 1000);
+
+    // An explicit band, the result stays in it.
+    params.band_offset = -500;
+    params.band_width = 3;
+    recon = LcskppSparseFast(long_a, long_b, params, &stats);
+    assert(recon.size() <= length);
+    assert(lcsk_plus ? ValidLcskpp(long_a, long_b, params.k, recon)
+                     : ValidLcsk(long_a, long_b, params.k, recon));
+    for (const auto &match : recon) {
+      assert(abs(match.first - match.second + 500) <= 3);
+    }
+    // Setting the band lets the planner choose the banded engine.
+    params.engine = LcskppParams::Engine::AUTO;
+    params.band_width = 100;
+    LcskppSparseFast(long_a, long_b, params, &stats);
+    assert(stats.engine == LcskppParams::Engine::BANDED);
+  }
+  printf("Test PASSED!\n");
+}
+
+void WavefrontTest() {
+  printf("WavefrontTest\n");
+  SequenceGenerator generator(1604);
+  MutationRates rates;
+  rates.substitution = 0.1;
+  rates.insertion = 0.01;
+  rates.deletion = 0.01;
+  const string a = generator.Random(20000);
+  const string b = generator.Mutate(a, rates);
+  for (bool lcsk_plus : {false, true}) {
+    for (int k : {3, 10}) {
+      // With 8 threads the columns are split into 4 stripes.
+      LcskppParams params(k);
+      params.lcsk_plus = lcsk_plus;
+      params.engine = LcskppParams::Engine::SPARSE;
+      LcskppStats stats;
+      const auto expected = LcskppSparseFast(a, b, params, &stats);
+      const uint64_t num_matches = stats.num_matches;
+      params.num_threads = 8;
+      const auto recon = LcskppSparseFast(a, b, params, &stats);
+      assert(recon.size() == expected.size());
+      assert(stats.num_matches == num_matches);
+      assert(lcsk_plus ? ValidLcskpp(a, b, k, recon)
+                       : ValidLcsk(a, b, k, recon));
+    }
+  }
+  printf("Test PASSED!\n");
+}
+
 void LcskppReverseTest() {
   printf("LcskppReverseTest\n");
   LcskppParams params(kK);
@@ -206,12 +459,1024 @@ void LcskppMultistartAggressiveTest() {
   printf("Test PASSED!\n");
 }
 
+void KmerIndexTest() {
+  printf("KmerIndexTest\n");
+  const int k = 7;
+  const string s = generate_string(300000);
+  vector<char> char_to_id(256, -1);
+  for (int i = 0; i < kNuc.size(); ++i) {
+    char_to_id[kNuc[i]] = i;
+  }
+
+  map<unsigned long long, vector<int>> expected;
+  RollingHasher hasher(s, k, char_to_id, kNuc.size());
+  unsigned long long hash;
+  for (int i = 0; hasher.Next(&hash); ++i) {
+    expected[hash].push_back(i);
+  }
+
+  // Enough threads for the string to be split into several chunks.
+  KmerIndex index;
+  index.Build(s, k, char_to_id, kNuc.size(), /*num_threads=*/4);
+  assert(index.num_keys() == expected.size());
+  for (const auto& kmer : expected) {
+    const uint32_t* begin;
+    const uint32_t* end;
+    assert(index.Find(kmer.first, &begin, &end));
+    assert(vector<int>(begin, end) == kmer.second);
+  }
+  const uint32_t* begin;
+  const uint32_t* end;
+  assert(!index.Find(1ULL << (2 * k), &begin, &end));
+
+  // Hashes whose slot is past the end of the directory are mixed in.
+  vector<unsigned long long> hashes;
+  for (unsigned long long hash = 0; hash <= 1ULL << (2 * k); ++hash) {
+    hashes.push_back(hash);
+    if (hash % 1000 == 0) hashes.push_back(~0ULL - hash);
+  }
+  vector<const uint32_t*> begins(hashes.size());
+  vector<const uint32_t*> ends(hashes.size());
+  index.FindBatch(hashes.data(), hashes.size(), begins.data(), ends.data());
+  for (int i = 0; i < hashes.size(); ++i) {
+    assert(vector<int>(begins[i], ends[i]) == expected[hashes[i]]);
+  }
+  printf("Test PASSED!\n");
+}
+
+void MatchesBlockTest() {
+  printf("MatchesBlockTest\n");
+  const int k = 4;
+  const string a = generate_string(2000);
+  const string b = generate_similar(a, kPerr);
+  for (auto type : {NAIVE, PERFECT_HASH}) {
+    auto match_maker = MatchMaker::Create(a, b, k, type);
+    MatchesBlock block;
+    match_maker->GetMatchesBlock(1500, a.size() + 1, &block);
+    vector<int> row_matches;
+    for (int row = 0; row <= a.size(); ++row) {
+      match_maker->GetNextMatches(&row_matches);
+      if (row < block.row_begin) continue;
+      int i = row - block.row_begin;
+      assert(row_matches == vector<int>(block.cols.begin() + block.offsets[i],
+                                        block.cols.begin() + block.offsets[i + 1]));
+    }
+  }
+
+  // Matches of the blocks are generated by several threads.
+  LcskppParams params(kK);
+  auto recon = LcskppSparseFast(a, b, params);
+  params.num_threads = 4;
+  const string long_a = generate_string(20000);
+  const string long_b = generate_similar(long_a, kPerr);
+  assert(LcskppSparseFast(a, b, params) == recon);
+  auto long_recon = LcskppSparseFast(long_a, long_b, params);
+  params.num_threads = 1;
+  assert(LcskppSparseFast(long_a, long_b, params) == long_recon);
+  printf("Test PASSED!\n");
+}
+
+void LiveMatchPairsTest() {
+  printf("LiveMatchPairsTest\n");
+  // Chains of a self comparison are a single diagonal run, which has to be
+  // kept in a constant number of pairs.
+  const string a = generate_string(20000);
+  LcskppStats stats;
+  auto recon = LcskppSparseFast(a, a, LcskppParams(10), &stats);
+  assert(recon.size() == a.size());
+  assert(stats.max_live_match_pairs < 100);
+  printf("Test PASSED!\n");
+}
+
+void LcskppStreamTest() {
+  printf("LcskppStreamTest\n");
+  LcskppParams params(kK);
+  params.reverse = true;
+  for (int i = 0; i < 100; ++i) {
+    // a contains characters which do not appear in b.
+    auto a = generate_string(kStringLen, "ACTGN");
+    auto b = generate_similar(a, kPerr);
+    b.erase(remove(b.begin(), b.end(), 'N'), b.end());
+    LcskppReference reference(b, params);
+
+    istringstream a_stream(a);
+    const auto expected = LcskppSparseFastRuns(a, b, params).runs;
+    assert(LcskppSparseFastStream(a_stream, reference, params).runs ==
+           expected);
+
+    // Blocks as short as a single character.
+    size_t position = 0;
+    auto read = [&](char *buffer, size_t size) -> size_t {
+      size = min(min(size, (size_t)(1 + rand() % 4)), a.size() - position);
+      copy(a.begin() + position, a.begin() + position + size, buffer);
+      position += size;
+      return size;
+    };
+    assert(LcskppSparseFastStream(read, reference, params).runs == expected);
+  }
+
+  // Params the reference does not support are reported, not computed.
+  const string a = generate_string(kStringLen);
+  LcskppReference reference(a, params);
+  LcskppParams other = params;
+  other.k = kK + 1;
+  istringstream a_stream(a);
+  const LcskppResult wrong_k = LcskppSparseFastStream(a_stream, reference,
+                                                      other);
+  assert(wrong_k.invalid_params && wrong_k.runs.empty());
+  other = params;
+  other.mode = LcskppParams::Mode::MULTISTART_AGGRESSIVE;
+  a_stream.clear();
+  a_stream.seekg(0);
+  assert(LcskppSparseFastStream(a_stream, reference, other).invalid_params);
+  a_stream.clear();
+  a_stream.seekg(0);
+  assert(!LcskppSparseFastStream(a_stream, reference, params).invalid_params);
+  printf("Test PASSED!\n");
+}
+
+void BudgetTest() {
+  printf("BudgetTest\n");
+  SequenceGenerator generator(1605);
+  MutationRates rates;
+  rates.substitution = 0.1;
+  const string a = generator.Random(20000);
+  const string b = generator.Mutate(a, rates);
+  LcskppParams params(kK);
+  params.engine = LcskppParams::Engine::SPARSE;
+  LcskppStats stats;
+  const LcskppResult full = LcskppSparseFastRuns(a, b, params, &stats);
+  assert(!full.partial && !stats.partial);
+  const uint64_t num_matches = stats.num_matches;
+
+  // A budget of half of the matches stops the dp halfway, with the best
+  // chain of the rows processed until then. The wavefront stops at the
+  // same row.
+  params.match_budget = num_matches / 2;
+  const LcskppResult half = LcskppSparseFastRuns(a, b, params, &stats);
+  assert(half.partial && stats.partial);
+  assert(stats.num_matches <= params.match_budget);
+  assert(half.size() > 0 && half.size() < full.size());
+  assert(ValidLcskpp(a, b, kK, half.ToPairs()));
+  params.num_threads = 8;
+  assert(LcskppSparseFastRuns(a, b, params).size() == half.size());
+  params.num_threads = 1;
+
+  // Budgets which are not used up change nothing.
+  params.match_budget = num_matches;
+  params.time_budget_seconds = 1000;
+  LcskppCancelToken token;
+  params.cancel_token = &token;
+  const LcskppResult unused = LcskppSparseFastRuns(a, b, params);
+  assert(!unused.partial && unused.runs == full.runs);
+
+  // Multistart runs stop too.
+  params.mode = LcskppParams::Mode::MULTISTART_AGGRESSIVE;
+  const size_t multistart = LcskppSparseFast(a, b, params).size();
+  params.match_budget = num_matches / 2;
+  assert(LcskppSparseFastRuns(a, b, params).partial);
+  assert(LcskppSparseFast(a, b, params).size() < multistart);
+  params.mode = LcskppParams::Mode::SINGLESTART;
+
+  // A cancelled call returns right away.
+  params.match_budget = 0;
+  token.Cancel();
+  const LcskppResult cancelled = LcskppSparseFastRuns(a, b, params);
+  assert(cancelled.partial && cancelled.size() == 0);
+
+  // Cancelling a streamed call while it reads a.
+  LcskppCancelToken stream_token;
+  params.cancel_token = &stream_token;
+  LcskppReference reference(b, params);
+  size_t position = 0;
+  auto read = [&](char *buffer, size_t size) -> size_t {
+    if (position > 0) stream_token.Cancel();
+    size = min(min(size, (size_t)1000), a.size() - position);
+    copy(a.begin() + position, a.begin() + position + size, buffer);
+    position += size;
+    return size;
+  };
+  const LcskppResult streamed = LcskppSparseFastStream(read, reference, params);
+  assert(streamed.partial && position < a.size());
+  assert(streamed.size() > 0 && streamed.size() < full.size());
+  printf("Test PASSED!\n");
+}
+
+void MinScoreTest() {
+  printf("MinScoreTest\n");
+  SequenceGenerator generator(1606);
+  MutationRates rates;
+  rates.substitution = 0.2;
+  rates.insertion = 0.02;
+  rates.deletion = 0.02;
+  for (bool lcsk_plus : {false, true}) {
+    for (int k : {3, 6}) {
+      // The bound never stops a run which can still reach min_score.
+      for (int i = 0; i < 100; ++i) {
+        const string a = generator.Random(300);
+        const string b = generator.Mutate(a, rates);
+        LcskppParams params(k);
+        params.lcsk_plus = lcsk_plus;
+        params.engine = LcskppParams::Engine::SPARSE;
+        const size_t length = LcskppSparseFast(a, b, params).size();
+        params.min_score = length;
+        assert(LcskppSparseFast(a, b, params).size() == length);
+        params.min_score = length + 1;
+        const LcskppResult result = LcskppSparseFastRuns(a, b, params);
+        assert(result.size() <= length);
+      }
+    }
+  }
+
+  // Similar strings stop once the score is reached.
+  const string a = generator.Random(20000);
+  const string b = generator.Mutate(a, rates);
+  LcskppParams params(10);
+  params.engine = LcskppParams::Engine::SPARSE;
+  LcskppStats stats;
+  const size_t length = LcskppSparseFast(a, b, params, &stats).size();
+  const uint64_t num_matches = stats.num_matches;
+  params.min_score = length / 2;
+  LcskppResult result = LcskppSparseFastRuns(a, b, params, &stats);
+  assert(result.partial && stats.partial);
+  assert(result.size() >= params.min_score && result.size() < length);
+  assert(stats.num_matches < num_matches);
+  assert(ValidLcskpp(a, b, 10, result.ToPairs()));
+  // So does the run on reversed b.
+  params.reverse = true;
+  assert(LcskppSparseFastRuns(a, b, params).size() == result.size());
+  params.reverse = false;
+
+  // Unrelated strings have too few matches (about 400) to reach 5000,
+  // nothing is processed.
+  const string unrelated = generator.Random(20000);
+  params.min_score = 5000;
+  result = LcskppSparseFastRuns(a, unrelated, params, &stats);
+  assert(result.partial && stats.num_matches == 0);
+  printf("Test PASSED!\n");
+}
+
+void PositionBitsTest() {
+  printf("PositionBitsTest\n");
+  // 64-bit positions are only needed for huge strings, they are forced here
+  // and have to give the same results as 32-bit ones.
+  for (int i = 0; i < 60; ++i) {
+    auto a = generate_string(kStringLen);
+    auto b = generate_similar(a, kPerr);
+    LcskppParams params(kK);
+    params.engine = LcskppParams::Engine::SPARSE;
+    params.lcsk_plus = i % 2 == 0;
+    params.reverse = i % 3 == 0;
+    params.num_threads = 1 + i % 3;
+    if (i % 5 == 1) params.mode = LcskppParams::Mode::MULTISTART_AGGRESSIVE;
+    if (i % 5 == 2) params.mode = LcskppParams::Mode::MULTISTART_2D_LOGARITHMIC;
+    if (i % 7 == 3) params.min_score = kStringLen / 4;
+    params.position_bits = 32;
+    const LcskppResult narrow = LcskppSparseFastRuns(a, b, params);
+    params.position_bits = 64;
+    const LcskppResult wide = LcskppSparseFastRuns(a, b, params);
+    assert(wide.runs == narrow.runs && wide.partial == narrow.partial);
+
+    // Streamed calls do not stop at min_score.
+    if (params.mode == LcskppParams::Mode::SINGLESTART &&
+        params.min_score == 0) {
+      LcskppReference reference(b, params);
+      for (int bits : {32, 64}) {
+        params.position_bits = bits;
+        istringstream a_stream(a);
+        assert(LcskppSparseFastStream(a_stream, reference, params).runs ==
+               narrow.runs);
+      }
+
+      // A bound on the length of a gives 32-bit positions, without one
+      // they are 64-bit.
+      params.position_bits = 0;
+      LcskppStats stats;
+      for (int64_t bound : {(int64_t)0, (int64_t)a.size()}) {
+        params.max_a_length = bound;
+        istringstream a_stream(a);
+        assert(LcskppSparseFastStream(a_stream, reference, params, &stats)
+                   .runs == narrow.runs);
+        assert(stats.position_bits == (bound > 0 ? 32 : 64));
+      }
+      // a longer than the bound is reported.
+      params.max_a_length = a.size() - 1;
+      istringstream a_stream(a);
+      const LcskppResult too_long =
+          LcskppSparseFastStream(a_stream, reference, params);
+      assert(too_long.invalid_params && too_long.runs.empty());
+    }
+  }
+
+  // The wavefront dp splits long strings between the threads.
+  auto a = generate_string(100000);
+  auto b = generate_similar(a, kPerr);
+  LcskppParams params(8);
+  params.num_threads = 3;
+  params.position_bits = 32;
+  const LcskppResult narrow = LcskppSparseFastRuns(a, b, params);
+  params.position_bits = 64;
+  assert(LcskppSparseFastRuns(a, b, params).runs == narrow.runs);
+  // 64-bit positions only run on the sparse engine.
+  params.engine = LcskppParams::Engine::BANDED;
+  assert(!LcskppParamsValid(a, b, params));
+  params.engine = LcskppParams::Engine::AUTO;
+  params.position_bits = 16;
+  assert(!LcskppParamsValid(a, b, params));
+  printf("Test PASSED!\n");
+}
+
+void SweepTest() {
+  printf("SweepTest\n");
+  const vector<int> ks = {8, 3, 5, 2, 5, 12};
+  for (int i = 0; i < 20; ++i) {
+    // Repeats give runs which overlap on many rows.
+    auto a = generate_string(200 + rand() % 300, i % 2 ? "AC" : "ACTG");
+    a += a.substr(0, a.size() / 2);
+    auto b = generate_similar(a, kPerr);
+    LcskppParams params;
+    params.lcsk_plus = i % 4 < 2;
+    params.reverse = i % 3 == 0;
+    params.num_threads = 1 + i % 3;
+    LcskppStats stats;
+    const auto results = LcskppSparseFastSweep(a, b, ks, params, &stats);
+    assert(results.size() == ks.size());
+    for (int j = 0; j < ks.size(); ++j) {
+      LcskppParams k_params = params;
+      k_params.k = ks[j];
+      k_params.num_threads = 1;
+      k_params.engine = LcskppParams::Engine::SPARSE;
+      assert(!results[j].partial);
+      assert(results[j].runs == LcskppSparseFastRuns(a, b, k_params).runs);
+    }
+  }
+  assert(LcskppSparseFastSweep("ACGT", "ACGT", {}, LcskppParams()).empty());
+  printf("Test PASSED!\n");
+}
+
+void ProfileTest() {
+  printf("ProfileTest\n");
+  for (int i = 0; i < 30; ++i) {
+    // Repeats give runs which reach over several windows.
+    auto a = generate_string(300 + rand() % 700, i % 2 ? "AC" : "ACTG");
+    a += a.substr(0, a.size() / 3);
+    auto b = generate_similar(a, kPerr);
+    if (i % 5 == 0) b = b.substr(0, b.size() / 2);
+    const int window = 50 + rand() % 200;
+    const int stride = 1 + rand() % (window + 20);
+    LcskppParams params(2 + rand() % 6);
+    params.lcsk_plus = i % 4 < 2;
+    params.reverse = i % 3 == 0;
+    params.num_threads = 1 + i % 3;
+    const LcskppProfile profile =
+        LcskppSparseFastProfile(a, b, window, stride, params);
+    assert(!profile.partial);
+    const size_t length = max(a.size(), b.size());
+    assert((profile.scores.size() - 1) * stride + window >= length);
+    assert(profile.scores.size() == 1 ||
+           (profile.scores.size() - 2) * stride + window < length);
+    params.num_threads = 1;
+    params.engine = LcskppParams::Engine::SPARSE;
+    for (int j = 0; j < profile.scores.size(); ++j) {
+      const size_t start = j * stride;
+      const string a_window = a.substr(min(start, a.size()), window);
+      const string b_window = b.substr(min(start, b.size()), window);
+      assert(profile.scores[j] ==
+             LcskppSparseFastRuns(a_window, b_window, params).size());
+    }
+  }
+
+  // A cancelled call leaves the windows empty.
+  auto a = generate_string(10000);
+  auto b = generate_similar(a, kPerr);
+  LcskppParams params(kK);
+  LcskppCancelToken token;
+  token.Cancel();
+  params.cancel_token = &token;
+  const LcskppProfile cancelled =
+      LcskppSparseFastProfile(a, b, 1000, 100, params);
+  assert(cancelled.partial && cancelled.scores.size() == 91);
+  assert(*max_element(cancelled.scores.begin(), cancelled.scores.end()) == 0);
+  printf("Test PASSED!\n");
+}
+
+void SamplingTest() {
+  printf("SamplingTest\n");
+  for (int i = 0; i < 40; ++i) {
+    auto a = generate_string(2000 + rand() % 3000);
+    auto b = generate_similar(a, i % 2 ? kPerr : 0.2);
+    LcskppParams params(4 + rand() % 9);
+    params.lcsk_plus = i % 4 < 2;
+    params.reverse = i % 5 == 0;
+    params.num_threads = 1 + i % 3;
+    const LcskppResult exact = LcskppSparseFastRuns(a, b, params);
+    assert(exact.upper_bound == 0 && exact.estimated_size == 0);
+    params.row_sampling = 2 + rand() % 6;
+    params.hash_row_sampling = i % 3 == 1;
+    const LcskppResult sampled = LcskppSparseFastRuns(a, b, params);
+    assert(sampled.size() <= exact.size());
+    assert(exact.size() <= sampled.upper_bound);
+    assert(sampled.size() <= sampled.estimated_size);
+    assert(sampled.estimated_size <= sampled.upper_bound);
+    if (!params.reverse) {
+      // The sampled chain is a valid one.
+      const auto recon = LcskppSparseFast(a, b, params);
+      assert(params.lcsk_plus ? ValidLcskpp(a, b, params.k, recon)
+                              : ValidLcsk(a, b, params.k, recon));
+    }
+  }
+
+  // Only SINGLESTART calls of the sparse engine without a min score sample.
+  const string a = generate_string(1000);
+  LcskppParams params(kK);
+  params.row_sampling = 2;
+  params.min_score = 10;
+  assert(LcskppSparseFastRuns(a, a, params).invalid_params);
+  params.min_score = 0;
+  params.mode = LcskppParams::Mode::MULTISTART_AGGRESSIVE;
+  assert(LcskppSparseFastRuns(a, a, params).invalid_params);
+  params.mode = LcskppParams::Mode::SINGLESTART;
+  params.engine = LcskppParams::Engine::BANDED;
+  assert(LcskppSparseFastRuns(a, a, params).invalid_params);
+  printf("Test PASSED!\n");
+}
+
+void ResultCacheTest() {
+  printf("ResultCacheTest\n");
+  auto a = generate_string(3000);
+  auto b = generate_similar(a, kPerr);
+  LcskppParams params(kK);
+  params.reverse = true;
+
+  // Only the fields which change a complete result change the key.
+  const LcskppCacheKey key = LcskppCallKey(a, b, params);
+  assert(!(LcskppCallKey(b, a, params) == key));
+  assert(!(LcskppCallKey(a + b, "", params) == LcskppCallKey(a, b, params)));
+  LcskppParams other = params;
+  other.k = kK + 1;
+  assert(!(LcskppCallKey(a, b, other) == key));
+  other = params;
+  other.row_sampling = 2;
+  assert(!(LcskppCallKey(a, b, other) == key));
+  other = params;
+  other.num_threads = 3;
+  assert(!(LcskppCallKey(a, b, other) == key));
+  other = params;
+  other.time_budget_seconds = 10;
+  assert(LcskppCallKey(a, b, other) == key);
+
+  const LcskppResult expected = LcskppSparseFastRuns(a, b, params);
+  LcskppResultCache cache(1 << 20);
+  for (int i = 0; i < 3; ++i) {
+    LcskppStats stats;
+    assert(cache.Runs(a, b, params, &stats).runs == expected.runs);
+    assert(i == 0 || stats.num_matches == 0);
+  }
+  assert(cache.Pairs(a, b, params) == expected.ToPairs());
+  LcskppCacheCounters counters = cache.counters();
+  assert(counters.misses == 1 && counters.hits == 3);
+  assert(counters.entries == 1 && counters.bytes > 0);
+
+  // Partial results are not cached.
+  LcskppCancelToken token;
+  token.Cancel();
+  other = params;
+  other.cancel_token = &token;
+  assert(cache.Runs(a, b + "A", other).partial);
+  assert(cache.Runs(a, b + "A", other).partial);
+  assert(cache.counters().misses == 3 && cache.counters().entries == 1);
+
+  // The least recently used results are dropped to stay in the budget.
+  LcskppResultCache small(counters.bytes * 2);
+  const vector<string> bs = {b, b + "A", b + "C"};
+  for (const string& bi : bs) small.Runs(a, bi, params);
+  small.Runs(a, bs[2], params);
+  counters = small.counters();
+  assert(counters.entries <= 2 && counters.bytes <= 2 * cache.counters().bytes);
+  assert(counters.hits == 1 && counters.misses == 3);
+  small.Runs(a, bs[0], params);
+  assert(small.counters().misses == 4);
+
+  // Results in the directory outlive the cache.
+  char directory[] = "/tmp/lcsk_cache_XXXXXX";
+  assert(mkdtemp(directory) != nullptr);
+  {
+    LcskppResultCache disk_cache(1 << 20, directory);
+    disk_cache.Runs(a, b, params);
+  }
+  LcskppResultCache disk_cache(0, directory);
+  assert(disk_cache.Runs(a, b, params).runs == expected.runs);
+  assert(disk_cache.Runs(a, b, params).runs == expected.runs);
+  counters = disk_cache.counters();
+  assert(counters.disk_hits == 2 && counters.misses == 0);
+  LcskppResult loaded;
+  const string path = LcskppCachePath(directory, key);
+  assert(LoadCachedResult(path, key, &loaded) && loaded.runs == expected.runs);
+  assert(!LoadCachedResult(path, LcskppCallKey(a, a, params), &loaded));
+
+  // Files which are cut, extended or changed are rejected.
+  string bytes;
+  {
+    ifstream in(path, ios::binary);
+    bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  auto load_bytes = [&](const string& contents) {
+    ofstream(path, ios::binary).write(contents.data(), contents.size());
+    return LoadCachedResult(path, key, &loaded);
+  };
+  assert(load_bytes(bytes));
+  assert(!load_bytes(bytes.substr(0, bytes.size() - 1)));
+  assert(!load_bytes(bytes + '\0'));
+  string changed = bytes;
+  changed[bytes.size() / 2] ^= 1;
+  assert(!load_bytes(changed));
+  assert(!load_bytes(""));
+  remove(path.c_str());
+  remove(directory);
+  printf("Test PASSED!\n");
+}
+
+void CApiTest() {
+  printf("CApiTest\n");
+  assert(lcsk_abi_version() == LCSK_ABI_VERSION);
+  lcsk_params c_params;
+  lcsk_default_params(&c_params);
+  c_params.k = kK;
+  c_params.reverse = 1;
+  LcskppParams params(kK);
+  params.reverse = true;
+
+  vector<string> as, bs;
+  vector<lcsk_pair> pairs;
+  for (int i = 0; i < 20; ++i) {
+    as.push_back(generate_string(100 + rand() % 2000));
+    bs.push_back(generate_similar(as.back(), kPerr));
+  }
+  // Strings are passed by length, they may hold null characters.
+  as[3][10] = bs[3][10] = 0;
+  for (int i = 0; i < as.size(); ++i) {
+    pairs.push_back({as[i].data(), as[i].size(), bs[i].data(), bs[i].size()});
+  }
+
+  auto check_runs = [](const LcskppResult& expected, const lcsk_run* runs) {
+    for (const LcskppRun& run : expected.runs) {
+      assert(run.a_start == runs->a_start && run.b_start == runs->b_start &&
+             run.length == runs->length && run.reverse == runs->reverse);
+      ++runs;
+    }
+  };
+
+  const LcskppResult expected = LcskppSparseFastRuns(as[3], bs[3], params);
+  vector<lcsk_run> runs(expected.runs.size());
+  lcsk_result result;
+  assert(lcsk_compute(pairs[3].a, pairs[3].a_length, pairs[3].b,
+                      pairs[3].b_length, &c_params, runs.data(), runs.size(),
+                      &result) == LCSK_OK);
+  assert(result.size == expected.size() && !result.partial);
+  assert(result.num_runs == expected.runs.size());
+  check_runs(expected, runs.data());
+  assert(lcsk_compute(pairs[3].a, pairs[3].a_length, pairs[3].b,
+                      pairs[3].b_length, &c_params, runs.data(),
+                      runs.size() - 1, &result) == LCSK_ERROR_CAPACITY);
+  assert(result.num_runs == expected.runs.size());
+
+  lcsk_params invalid = c_params;
+  invalid.mode = LCSK_MODE_MULTISTART_AGGRESSIVE;
+  invalid.engine = LCSK_ENGINE_BANDED;
+  assert(lcsk_compute(pairs[3].a, pairs[3].a_length, pairs[3].b,
+                      pairs[3].b_length, &invalid, runs.data(), runs.size(),
+                      &result) == LCSK_ERROR_INVALID_ARGUMENT);
+  invalid = c_params;
+  invalid.row_sampling = 2;
+  invalid.min_score = 10;
+  assert(lcsk_compute(pairs[3].a, pairs[3].a_length, pairs[3].b,
+                      pairs[3].b_length, &invalid, runs.data(), runs.size(),
+                      &result) == LCSK_ERROR_INVALID_ARGUMENT);
+  invalid = c_params;
+  invalid.num_threads = -1;
+  assert(lcsk_compute(pairs[3].a, pairs[3].a_length, pairs[3].b,
+                      pairs[3].b_length, &invalid, runs.data(), runs.size(),
+                      &result) == LCSK_ERROR_INVALID_ARGUMENT);
+  // The batch is rejected before any of the pairs is read.
+  assert(lcsk_compute_batch(pairs.data(), pairs.size(), &invalid, runs.data(),
+                            runs.size(), nullptr) ==
+         LCSK_ERROR_INVALID_ARGUMENT);
+  assert(lcsk_compute_batch(nullptr, (size_t)INT_MAX + 1, &c_params, nullptr,
+                            0, nullptr) == LCSK_ERROR_INVALID_ARGUMENT);
+
+  c_params.num_threads = 3;
+  size_t total_runs = 0;
+  vector<LcskppResult> expected_results;
+  for (int i = 0; i < as.size(); ++i) {
+    expected_results.push_back(LcskppSparseFastRuns(as[i], bs[i], params));
+    total_runs += expected_results.back().runs.size();
+  }
+  runs.resize(total_runs);
+  vector<lcsk_result> results(pairs.size());
+  assert(lcsk_compute_batch(pairs.data(), pairs.size(), &c_params, runs.data(),
+                            runs.size(), results.data()) == LCSK_OK);
+  for (int i = 0; i < pairs.size(); ++i) {
+    assert(results[i].status == LCSK_OK);
+    assert(results[i].size == expected_results[i].size());
+    check_runs(expected_results[i], runs.data() + results[i].runs_offset);
+  }
+
+  // Pairs from the first one which does not fit on are not written.
+  const size_t capacity = results[10].runs_offset + 1;
+  assert(lcsk_compute_batch(pairs.data(), pairs.size(), &c_params, runs.data(),
+                            capacity, results.data()) == LCSK_ERROR_CAPACITY);
+  for (int i = 0; i < pairs.size(); ++i) {
+    assert((results[i].status == LCSK_OK) == (i < 10));
+    assert(results[i].num_runs == expected_results[i].runs.size());
+  }
+  printf("Test PASSED!\n");
+}
+
+void ServerTest() {
+  printf("ServerTest\n");
+  // Lines are split however the input is read, a last line without a
+  // newline is returned too.
+  int fds[2];
+  assert(pipe(fds) == 0);
+  const string input = "first\n\nthird\n" + string(100000, 'A') + "\nlast";
+  thread writer([&] {
+    for (size_t written = 0; written < input.size();) {
+      const size_t size = min<size_t>(1 + rand() % 1000,
+                                      input.size() - written);
+      assert(write(fds[1], input.data() + written, size) == (ssize_t)size);
+      written += size;
+    }
+    close(fds[1]);
+  });
+  LineReader reader(fds[0]);
+  vector<string> lines;
+  string line;
+  while (reader.Next(&line)) lines.push_back(line);
+  writer.join();
+  close(fds[0]);
+  assert((lines == vector<string>{"first", "", "third", string(100000, 'A'),
+                                  "last"}));
+
+  LcskppResult result;
+  result.runs = {{0, 2, 5, false}, {7, 1, 3, true}};
+  result.partial = true;
+  assert(FormatResult("id", result) == "id\t8\tpartial\t0,2,5,+ 7,1,3,-");
+
+  // Requests are answered as the call on the strings of the files.
+  char directory[] = "/tmp/lcsk_server_XXXXXX";
+  assert(mkdtemp(directory) != nullptr);
+  const string a_path = string(directory) + "/a";
+  const string b_path = string(directory) + "/b";
+  const string a = generate_string(2000);
+  const string b = generate_similar(a, kPerr);
+  ofstream(a_path) << a << "\n";
+  ofstream(b_path) << b << "\n";
+  LcskppParams params(kK);
+  params.reverse = true;
+  ReferenceCache references(params, 1);
+  const string expected =
+      FormatResult("pair", LcskppSparseFastRuns(a, b, params));
+  const string request = "pair " + a_path + " " + b_path;
+  assert(ServeRequest(request, params, &references) == expected);
+  // The second time b is already indexed.
+  assert(references.Get(b_path) == references.Get(b_path));
+  // Concurrent requests for a new b share one index.
+  ReferenceCache fresh(params, 1);
+  vector<shared_ptr<const LcskppReference>> got(4);
+  vector<thread> getters;
+  for (auto& reference : got) {
+    getters.emplace_back([&] { reference = fresh.Get(b_path); });
+  }
+  for (auto& getter : getters) getter.join();
+  for (const auto& reference : got) {
+    assert(reference != nullptr && reference == got[0]);
+  }
+  assert(ServeRequest(" " + request + "\t", params, &references) == expected);
+  assert(ServeRequest("", params, &references).empty());
+  assert(ServeRequest("pair " + a_path, params, &references) ==
+         "pair\terror\texpected ID A_PATH B_PATH");
+  assert(ServeRequest(request + " extra", params, &references) ==
+         "pair\terror\texpected ID A_PATH B_PATH");
+  const string missing = string(directory) + "/missing";
+  assert(ServeRequest("pair " + missing + " " + b_path, params,
+                      &references) == "pair\terror\tcannot read " + missing);
+  assert(ServeRequest("pair " + a_path + " " + missing, params,
+                      &references) == "pair\terror\tcannot read " + missing);
+  remove(a_path.c_str());
+  remove(b_path.c_str());
+  remove(directory);
+  printf("Test PASSED!\n");
+}
+
+void SketchTest() {
+  printf("SketchTest\n");
+  const int kLength = 20000;
+  auto a = generate_string(kLength);
+  auto b = generate_similar(a, 0.02);
+  auto c = generate_string(kLength);
+  auto d = a.substr(kLength / 4, kLength / 10);
+  const vector<string> sequences = {a, b, c, d};
+
+  SketchParams frac_params;
+  frac_params.k = 12;
+  frac_params.scale = 10;
+  SketchParams bottom_params = frac_params;
+  bottom_params.sketch_size = 300;
+  for (const auto &params : {frac_params, bottom_params}) {
+    vector<Sketch> sketches;
+    for (const auto &s : sequences) sketches.emplace_back(s, params);
+    assert(sketches[0].Containment(sketches[1]) > 0.5);
+    assert(sketches[0].Containment(sketches[2]) < 0.05);
+    assert(sketches[3].Containment(sketches[0]) > 0.9);
+    assert(sketches[3].Containment(sketches[3]) == 1);
+
+    stringstream stream;
+    assert(sketches[1].Save(stream));
+    Sketch loaded;
+    assert(loaded.Load(stream));
+    assert(loaded.params() == params);
+    assert(loaded.num_kmers() == sketches[1].num_kmers());
+    assert(loaded.hashes() == sketches[1].hashes());
+    stringstream truncated(stream.str().substr(0, 20));
+    assert(!loaded.Load(truncated));
+
+    // Corrupted sketches are rejected: a FracMinHash one with scale 0 (the
+    // int32 after the 8 byte magic and k), unsorted and repeated hashes.
+    const string saved = stream.str();
+    const size_t last = saved.size() - sizeof(uint64_t);
+    if (params.sketch_size == 0) {
+      string zero_scale = saved;
+      fill(zero_scale.begin() + 12, zero_scale.begin() + 16, 0);
+      stringstream zero_scale_stream(zero_scale);
+      assert(!loaded.Load(zero_scale_stream));
+    }
+    string unsorted = saved;
+    swap_ranges(unsorted.begin() + last - sizeof(uint64_t),
+                unsorted.begin() + last, unsorted.begin() + last);
+    stringstream unsorted_stream(unsorted);
+    assert(!loaded.Load(unsorted_stream));
+    string repeated = saved;
+    copy(repeated.begin() + last, repeated.end(),
+         repeated.begin() + last - sizeof(uint64_t));
+    stringstream repeated_stream(repeated);
+    assert(!loaded.Load(repeated_stream));
+    // So are ks the hash does not fit, and counts of hashes past the end of
+    // the file, before the hashes are allocated.
+    for (int32_t k : {0, 100}) {
+      string wrong_k = saved;
+      memcpy(&wrong_k[8], &k, sizeof(k));
+      stringstream wrong_k_stream(wrong_k);
+      assert(!loaded.Load(wrong_k_stream));
+    }
+    string too_many = saved;
+    const size_t counts = 24 + params.alphabet.size();
+    const int32_t num_kmers = INT_MAX;
+    const uint64_t num_hashes = INT_MAX;
+    memcpy(&too_many[counts], &num_kmers, sizeof(num_kmers));
+    memcpy(&too_many[counts + sizeof(num_kmers)], &num_hashes,
+           sizeof(num_hashes));
+    stringstream too_many_stream(too_many);
+    assert(!loaded.Load(too_many_stream));
+
+    // c is unrelated to the rest.
+    const auto candidates = FindCandidatePairs(sketches, 0.2, 2);
+    assert(candidates.size() == 3);
+    for (const auto &candidate : candidates) {
+      assert(candidate.i < candidate.j && candidate.i != 2 &&
+             candidate.j != 2);
+    }
+    assert(FindCandidatePairs(sketches, 0).size() == 6);
+
+    LcskppParams lcskpp_params(10);
+    lcskpp_params.num_threads = 2;
+    const auto results =
+        LcskppCandidatePairs(sequences, sketches, 0.2, lcskpp_params);
+    assert(results.size() == 3);
+    for (const auto &result : results) {
+      assert(result.result.runs ==
+             LcskppSparseFastRuns(sequences[result.pair.i],
+                                  sequences[result.pair.j], LcskppParams(10))
+                 .runs);
+    }
+  }
+  printf("Test PASSED!\n");
+}
+
+void LcskppResultTest() {
+  printf("LcskppResultTest\n");
+  // Runs in both directions, interleaving and sharing pairs.
+  LcskppResult result;
+  result.runs = {{0, 5, 3, true}, {1, 10, 2, false}, {1, 4, 4, true},
+                 {2, 0, 5, false}, {3, 9, 1, false}};
+  vector<pair<int, int>> expected;
+  for (const auto &run : result.runs) {
+    for (int i = 0; i < run.length; ++i) {
+      expected.emplace_back(run.a_start + i, run.b_at(i));
+    }
+  }
+  sort(expected.begin(), expected.end());
+  expected.erase(unique(expected.begin(), expected.end()), expected.end());
+  NormalizeRuns(&result.runs);
+  assert(result.runs.size() == 4);
+  assert(result.ToPairs() == expected);
+
+  const int num_runs[] = {0, 3};
+  for (int runs : num_runs) {
+    for (int i = 0; i < 100; ++i) {
+      LcskppParams params(kK);
+      params.reverse = true;
+      params.mode = runs ? LcskppParams::Mode::MULTISTART_AGGRESSIVE
+                         : LcskppParams::Mode::SINGLESTART;
+      params.aggressive_runs = runs;
+      auto a = generate_string(kStringLen);
+      auto b = generate_similar(a, kPerr);
+      auto result = LcskppSparseFastRuns(a, b, params);
+      auto recon = result.ToPairs();
+      assert(recon.size() == result.size());
+      assert(is_sorted(recon.begin(), recon.end()));
+      for (const auto &match : recon) {
+        assert(a[match.first] == b[match.second]);
+      }
+      for (int j = 1; j < result.runs.size(); ++j) {
+        const LcskppRun &prev = result.runs[j - 1];
+        const LcskppRun &run = result.runs[j];
+        assert(make_pair(prev.a_start, prev.b_start) <=
+               make_pair(run.a_start, run.b_start));
+      }
+    }
+  }
+  printf("Test PASSED!\n");
+}
+
+void LcskppStatsTest() {
+  printf("LcskppStatsTest\n");
+  LcskppParams params(kK);
+  params.reverse = true;
+  const string a = generate_string(20000);
+  const string b = generate_similar(a, kPerr);
+  LcskppStats stats;
+  auto recon = LcskppSparseFast(a, b, params, &stats);
+
+  uint64_t num_matches = 0;
+  string b_reversed(b.rbegin(), b.rend());
+  const string bs[] = {b, b_reversed};
+  for (const string &other : bs) {
+    auto match_maker = MatchMaker::Create(a, other, kK, PERFECT_HASH);
+    vector<int> matches;
+    while (match_maker->GetNextMatches(&matches)) {
+      num_matches += matches.size();
+    }
+  }
+  assert(stats.num_matches == num_matches);
+  // Both runs go over the rows [0, a.size()].
+  const uint64_t num_rows = 2 * (a.size() + 1);
+  uint64_t histogram_rows = 0;
+  for (uint64_t rows : stats.row_match_histogram) {
+    histogram_rows += rows;
+  }
+  assert(histogram_rows == num_rows);
+  assert(stats.amortized_rows + stats.elementwise_rows == num_rows);
+  assert(stats.compressed_table_size > 0);
+  assert(stats.max_live_match_pairs <= stats.match_pairs_created);
+  assert(stats.dp_seconds > 0);
+
+  LcskppReference reference(b, params);
+  istringstream a_stream(a);
+  LcskppStats stream_stats;
+  LcskppSparseFastStream(a_stream, reference, params, &stream_stats);
+  assert(stream_stats.num_matches == stats.num_matches);
+  assert(stream_stats.row_match_histogram == stats.row_match_histogram);
+  printf("Test PASSED!\n");
+}
+
+void ConcurrentCallsTest() {
+  printf("ConcurrentCallsTest\n");
+  const int kNumThreads = 8;
+  const int kCallsPerThread = 50;
+  LcskppParams params(kK);
+  params.reverse = true;
+  // Inputs and expected results are prepared up front, rand is not thread
+  // safe.
+  vector<string> as, bs;
+  vector<LcskppResult> expected;
+  vector<LcskppStats> expected_stats;
+  for (int i = 0; i < kCallsPerThread; ++i) {
+    as.push_back(generate_string(1000));
+    bs.push_back(generate_similar(as.back(), kPerr));
+    expected_stats.emplace_back();
+    expected.push_back(
+        LcskppSparseFastRuns(as.back(), bs.back(), params,
+                             &expected_stats.back()));
+  }
+  const string &reference_b = bs[0];
+  LcskppReference reference(reference_b, params);
+
+  vector<int> failures(kNumThreads, 0);
+  vector<thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int j = 0; j < kCallsPerThread; ++j) {
+        // Threads go over the inputs in different orders.
+        const int i = (j + t * 7) % kCallsPerThread;
+        LcskppStats stats;
+        auto result = LcskppSparseFastRuns(as[i], bs[i], params, &stats);
+        if (!(result.runs == expected[i].runs) ||
+            stats.match_pairs_created != expected_stats[i].match_pairs_created ||
+            stats.max_live_match_pairs !=
+                expected_stats[i].max_live_match_pairs) {
+          ++failures[t];
+        }
+
+        // All of the threads share the reference.
+        istringstream a_stream(as[i]);
+        auto stream_result =
+            LcskppSparseFastStream(a_stream, reference, params);
+        if (!(stream_result.runs ==
+              LcskppSparseFastRuns(as[i], reference_b, params).runs)) {
+          ++failures[t];
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < kNumThreads; ++t) {
+    assert(failures[t] == 0);
+  }
+  printf("Test PASSED!\n");
+}
+
+void SequenceGeneratorTest() {
+  printf("SequenceGeneratorTest\n");
+  const int n = 100000;
+  assert(SequenceGenerator(7).Random(n) == SequenceGenerator(7).Random(n));
+  assert(SequenceGenerator(7).Random(n) != SequenceGenerator(8).Random(n));
+
+  SequenceGenerator generator(1603, "ACDEFGHIKLMNPQRSTVWY");
+  const string a = generator.Random(n);
+  assert(a.size() == n);
+  for (char c : a) {
+    assert(generator.alphabet().find(c) != string::npos);
+  }
+
+  MutationRates substitutions;
+  substitutions.substitution = 0.1;
+  const string b = generator.Mutate(a, substitutions);
+  assert(b.size() == n);
+  int differences = 0;
+  for (int i = 0; i < n; ++i) {
+    differences += a[i] != b[i];
+  }
+  assert(abs(differences - n / 10) < n / 100);
+
+  MutationRates insertions;
+  insertions.insertion = 0.1;
+  insertions.mean_indel_length = 3;
+  assert(abs((int)generator.Mutate(a, insertions).size() - (n + 3 * n / 10)) <
+         n / 50);
+  MutationRates deletions;
+  deletions.deletion = 0.1;
+  assert(abs((int)generator.Mutate(a, deletions).size() - (n - n / 10)) <
+         n / 50);
+
+  string c = a;
+  generator.AddTandemRepeats(&c, 10, 20, 25);
+  generator.AddSegmentalDuplications(&c, 10, 1000, 0.05);
+  assert(c.size() == n && c != a);
+  printf("Test PASSED!\n");
+}
+
 int main(int argc, char *argv[]) {
   srand(1603);
   LcskTest();
   LcskppTest();
+  LcskppIndelTest();
+  DenseLcskppTest();
+  DenseSparseTest();
+  PlannerTest();
+  BandedTest();
+  WavefrontTest();
   LcskppReverseTest();
   LcskppMultistartTest();
   LcskppMultistartAggressiveTest();
+  KmerIndexTest();
+  MatchesBlockTest();
+  LiveMatchPairsTest();
+  LcskppStreamTest();
+  BudgetTest();
+  MinScoreTest();
+  PositionBitsTest();
+  SweepTest();
+  ProfileTest();
+  SamplingTest();
+  ResultCacheTest();
+  CApiTest();
+  ServerTest();
+  SketchTest();
+  LcskppResultTest();
+  LcskppStatsTest();
+  ConcurrentCallsTest();
+  SequenceGeneratorTest();
   return 0;
 }
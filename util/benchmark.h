@@ -0,0 +1,93 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef BENCHMARK
+#define BENCHMARK
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Parameters of a benchmark, e.g. {"k", 12}.
+typedef std::vector<std::pair<std::string, double>> BenchmarkParams;
+
+struct BenchmarkResult {
+  std::string name;
+  BenchmarkParams params;
+  int iterations;
+  double min_seconds;
+  double median_seconds;
+  // Number of items (characters, rows, ...) processed by an iteration.
+  long long items;
+};
+
+// Runs benchmarks and collects their results, which are written as JSON.
+class BenchmarkRunner {
+ public:
+  // Every benchmark is repeated at least three times and until its measured
+  // time adds up to min_seconds.
+  explicit BenchmarkRunner(double min_seconds) : min_seconds_(min_seconds) {}
+
+  // body runs a single iteration and returns the time of its measured part,
+  // so it can do its setup without it being measured.
+  void Run(const std::string& name, const BenchmarkParams& params,
+           long long items, const std::function<double()>& body) {
+    std::vector<double> times;
+    double total = 0;
+    while (times.size() < 3 || total < min_seconds_) {
+      times.push_back(body());
+      total += times.back();
+    }
+    std::sort(times.begin(), times.end());
+
+    results_.push_back(BenchmarkResult{name, params, (int)times.size(),
+                                       times[0], times[times.size() / 2],
+                                       items});
+    fprintf(stderr, "%-24s", name.c_str());
+    for (const auto& param : params) {
+      fprintf(stderr, " %s=%g", param.first.c_str(), param.second);
+    }
+    fprintf(stderr, " %.6fs\n", times[times.size() / 2]);
+  }
+
+  void WriteJson(FILE* out) const {
+    fprintf(out, "[\n");
+    for (size_t i = 0; i < results_.size(); ++i) {
+      const BenchmarkResult& result = results_[i];
+      fprintf(out, "  {\"name\": \"%s\"", result.name.c_str());
+      for (const auto& param : result.params) {
+        fprintf(out, ", \"%s\": %.17g", param.first.c_str(), param.second);
+      }
+      fprintf(out,
+              ", \"iterations\": %d, \"min_seconds\": %.9f, "
+              "\"median_seconds\": %.9f, \"items\": %lld, "
+              "\"items_per_second\": %.1f}%s\n",
+              result.iterations, result.min_seconds, result.median_seconds,
+              result.items,
+              result.median_seconds > 0 ? result.items / result.median_seconds
+                                        : 0.0,
+              i + 1 < results_.size() ? "," : "");
+    }
+    fprintf(out, "]\n");
+  }
+
+ private:
+  const double min_seconds_;
+  std::vector<BenchmarkResult> results_;
+};
+
+#endif  // BENCHMARK
@@ -15,25 +15,73 @@
 #ifndef OBJECT_COUNTER
 #define OBJECT_COUNTER
 
-template <typename T>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Counts the objects allocated through CountingAllocators pointing to it.
+// The objects may be created and destroyed by several threads at once (the
+// wavefront dp passes MatchPairs between threads), so the counts are atomic.
+// They are only ever read once the threads are done.
 struct ObjectCounter {
-  ObjectCounter() {
-    objects_created++;
-    objects_alive++;
-    max_objects_alive = std::max(max_objects_alive, objects_alive);
+  std::atomic<uint64_t> objects_created{0};
+  std::atomic<uint64_t> objects_alive{0};
+  std::atomic<uint64_t> max_objects_alive{0};
+
+  void Created() {
+    objects_created.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t alive =
+        objects_alive.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t max_alive = max_objects_alive.load(std::memory_order_relaxed);
+    while (max_alive < alive &&
+           !max_objects_alive.compare_exchange_weak(
+               max_alive, alive, std::memory_order_relaxed)) {
+    }
+  }
+
+  void Destroyed() {
+    objects_alive.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
+// Allocator which counts the allocations in an ObjectCounter, meant for
+// std::allocate_shared. The counter has to outlive the allocated objects.
+template <typename T>
+class CountingAllocator {
+ public:
+  typedef T value_type;
+
+  explicit CountingAllocator(ObjectCounter* counter) : counter_(counter) {}
+
+  template <typename U>
+  CountingAllocator(const CountingAllocator<U>& other)
+      : counter_(other.counter()) {}
+
+  T* allocate(std::size_t n) {
+    counter_->Created();
+    return std::allocator<T>().allocate(n);
   }
 
-  virtual ~ObjectCounter() {
-    --objects_alive;
+  void deallocate(T* p, std::size_t n) {
+    counter_->Destroyed();
+    std::allocator<T>().deallocate(p, n);
   }
 
-  static uint64_t objects_created;
-  static uint64_t objects_alive;
-  static uint64_t max_objects_alive;
+  ObjectCounter* counter() const { return counter_; }
+
+ private:
+  ObjectCounter* counter_;
 };
 
-template <typename T> uint64_t ObjectCounter<T>::objects_created(0);
-template <typename T> uint64_t ObjectCounter<T>::objects_alive(0);
-template <typename T> uint64_t ObjectCounter<T>::max_objects_alive(0);
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& a, const CountingAllocator<U>& b) {
+  return a.counter() == b.counter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& a, const CountingAllocator<U>& b) {
+  return a.counter() != b.counter();
+}
 
 #endif
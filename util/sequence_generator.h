@@ -0,0 +1,207 @@
+// Copyright 2018 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SEQUENCE_GENERATOR
+#define SEQUENCE_GENERATOR
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// xoshiro256** pseudorandom generator, seeded through splitmix64.
+class Xoshiro256 {
+ public:
+  explicit Xoshiro256(uint64_t seed) {
+    for (int i = 0; i < 4; ++i) {
+      seed += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s_[i] = z ^ (z >> 31);
+    }
+  }
+
+  uint64_t Next() {
+    const uint64_t result = Rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = Rotl(s_[3], 45);
+    return result;
+  }
+
+  // Uniform in [0, n), n has to be positive.
+  uint64_t Uniform(uint64_t n) {
+    return (uint64_t)(((unsigned __int128)Next() * n) >> 64);
+  }
+
+  // Uniform in [0, 1).
+  double UniformReal() { return (Next() >> 11) * (1.0 / (1ULL << 53)); }
+
+ private:
+  static uint64_t Rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t s_[4];
+};
+
+// Rates of the mutations applied by SequenceGenerator::Mutate, per
+// character of the source.
+struct MutationRates {
+  double substitution = 0;
+  double insertion = 0;
+  double deletion = 0;
+  // Lengths of insertions and deletions are geometric with this mean.
+  double mean_indel_length = 1;
+};
+
+// Fast, seedable generator of synthetic sequences. The same seed always
+// gives the same sequences.
+class SequenceGenerator {
+ public:
+  explicit SequenceGenerator(uint64_t seed,
+                             const std::string& alphabet = "ACTG")
+      : rng_(seed), alphabet_(alphabet) {
+    assert(!alphabet_.empty());
+    bits_ = 0;
+    while ((1u << bits_) < alphabet_.size()) {
+      ++bits_;
+    }
+  }
+
+  const std::string& alphabet() const { return alphabet_; }
+
+  // Uniformly random sequence of length n.
+  std::string Random(size_t n) {
+    std::string s(n, 0);
+    if ((1u << bits_) == alphabet_.size() && bits_ > 0) {
+      // A power of two alphabet takes several characters from one number.
+      const int per_number = 64 / bits_;
+      const uint64_t mask = (1ULL << bits_) - 1;
+      size_t i = 0;
+      while (i < n) {
+        uint64_t x = rng_.Next();
+        for (int j = 0; j < per_number && i < n; ++j, ++i, x >>= bits_) {
+          s[i] = alphabet_[x & mask];
+        }
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        s[i] = RandomChar();
+      }
+    }
+    return s;
+  }
+
+  // Copy of s with substitutions (always to a different character),
+  // insertions of random characters and deletions.
+  std::string Mutate(const std::string& s, const MutationRates& rates) {
+    const double rate = rates.substitution + rates.insertion + rates.deletion;
+    if (rate <= 0) return s;
+    std::string t;
+    t.reserve(s.size() + (size_t)(s.size() * rates.insertion *
+                                  rates.mean_indel_length * 2) + 16);
+    // Distances between the mutations are geometric, so the characters in
+    // between are copied at once.
+    const double log_keep = std::log(1 - std::min(rate, 1.0 - 1e-12));
+    size_t i = 0;
+    while (true) {
+      const double skip = std::floor(std::log(1 - rng_.UniformReal()) /
+                                     log_keep);
+      if (skip >= s.size() - i) break;
+      t.append(s, i, (size_t)skip);
+      i += (size_t)skip;
+
+      const double type = rng_.UniformReal() * rate;
+      if (type < rates.substitution) {
+        t.push_back(Substitute(s[i]));
+        ++i;
+      } else if (type < rates.substitution + rates.insertion) {
+        for (int j = IndelLength(rates); j > 0; --j) {
+          t.push_back(RandomChar());
+        }
+        t.push_back(s[i]);
+        ++i;
+      } else {
+        i = std::min(s.size(), i + IndelLength(rates));
+      }
+      if (i >= s.size()) break;
+    }
+    if (i < s.size()) t.append(s, i, std::string::npos);
+    return t;
+  }
+
+  // Overwrites count random places of s with tandem repeats: a random unit
+  // of length unit_length repeated copies times. The length of s does not
+  // change.
+  void AddTandemRepeats(std::string* s, int count, int unit_length,
+                        int copies) {
+    const size_t length = (size_t)unit_length * copies;
+    if (unit_length <= 0 || length > s->size()) return;
+    for (int i = 0; i < count; ++i) {
+      const std::string unit = Random(unit_length);
+      size_t position = rng_.Uniform(s->size() - length + 1);
+      for (int j = 0; j < copies; ++j, position += unit_length) {
+        s->replace(position, unit_length, unit);
+      }
+    }
+  }
+
+  // Copies count random segments of s of the given length over other
+  // random places of s, substituting a divergence fraction of the copied
+  // characters. The length of s does not change.
+  void AddSegmentalDuplications(std::string* s, int count, int length,
+                                double divergence) {
+    if (length <= 0 || (size_t)length > s->size()) return;
+    MutationRates rates;
+    rates.substitution = divergence;
+    for (int i = 0; i < count; ++i) {
+      const size_t source = rng_.Uniform(s->size() - length + 1);
+      const size_t target = rng_.Uniform(s->size() - length + 1);
+      s->replace(target, length, Mutate(s->substr(source, length), rates));
+    }
+  }
+
+ private:
+  char RandomChar() { return alphabet_[rng_.Uniform(alphabet_.size())]; }
+
+  char Substitute(char c) {
+    if (alphabet_.size() == 1) return c;
+    char d;
+    do {
+      d = RandomChar();
+    } while (d == c);
+    return d;
+  }
+
+  int IndelLength(const MutationRates& rates) {
+    if (rates.mean_indel_length <= 1) return 1;
+    // Geometric on {1, 2, ...} with the given mean.
+    const double p = 1 / rates.mean_indel_length;
+    return 1 + (int)std::floor(std::log(1 - rng_.UniformReal()) /
+                               std::log(1 - p));
+  }
+
+  Xoshiro256 rng_;
+  std::string alphabet_;
+  int bits_;
+};
+
+#endif  // SEQUENCE_GENERATOR